@@ -5,6 +5,29 @@
 #include <random>
 #include <memory>
 #include <cmath>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <numeric>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <tuple>
+
+// The vectorized kernels use GCC/Clang target attributes, so they are only built for x86 on those compilers.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define RAYCAST_X86_SIMD
+    #include <immintrin.h>
+#endif
 // ------------------------------------------------------------------------
 
 constexpr float Width  = 800;
@@ -22,15 +45,23 @@ static inline float distance(const sf::Vector2f p1, const sf::Vector2f p2) {
 }
 // ------------------------------------------------------------------------
 
+// Generate a random number between min and max from the given generator, the same seed gives the same numbers.
+template<typename T>
+static T random(std::mt19937& gen, T min, T max)
+{
+	std::uniform_real_distribution<> dis(min, max);
+
+	return static_cast<T>(dis(gen));
+}
+
 // Simply generate a random number between min and max.
 template<typename T>
 static T random(T min, T max) 
 {
 	std::random_device rd;
 	std::mt19937 gen(rd());
-	std::uniform_real_distribution<> dis(min, max);
 
-	return static_cast<T>(dis(gen));
+	return random(gen, min, max);
 }
 // ------------------------------------------------------------------------
 
@@ -87,7 +118,7 @@ static sf::Vector2f pointIntersection(const sf::Vector2f A, const sf::Vector2f B
     // Determinant 
     const float det = a1 * b2 - a2 * b1;
 
-    float x, y;
+    float x = 0.f, y = 0.f;
 
     if(det == 0.f)
     {
@@ -115,136 +146,1864 @@ static inline bool intersection(const sf::Vector2f A, const sf::Vector2f B, cons
 }
 // ------------------------------------------------------------------------
 
-// Creates a shape with random points and size at the mouse position
-static sf::CircleShape createShape(const sf::Vector2i mousepos)
+// A shape's edge in world coordinates.
+struct Edge { sf::Vector2f a, b; };
+// ------------------------------------------------------------------------
+
+// The world space edges of the shapes as a structure of arrays, edge i goes from (x0[i], y0[i]) to (x1[i], y1[i]).
+// A shape's points are transformed once, when it's added or changed, instead of twice per vertex every frame.
+// Every edge starts at a vertex of its shape, so the rays to the vertices come from the same arrays.
+struct EdgeBuffer
 {
-    sf::CircleShape shape;
+    std::vector<float> x0, y0, x1, y1;
 
-    shape.setFillColor(sf::Color::Transparent);
-    shape.setOutlineColor(sf::Color::Black);
-    shape.setOutlineThickness(1);
-    shape.setPointCount(random(3, 10));
-    shape.setRadius(random(30, 120));
-    shape.setOrigin(sf::Vector2f(shape.getRadius(), shape.getRadius()));
-    shape.setPosition(vector_cast<float>(mousepos));
+    // Where every shape's edges start, a shape with n points owns the n edges from there
+    std::vector<unsigned int> shapeFirst;
 
-    return shape;
+    size_t size() const { return x0.size(); }
+
+    Edge edge(const size_t i) const { return Edge { sf::Vector2f(x0[i], y0[i]), sf::Vector2f(x1[i], y1[i]) }; }
+
+    void push(const Edge& edge)
+    {
+        x0.push_back(edge.a.x);
+        y0.push_back(edge.a.y);
+        x1.push_back(edge.b.x);
+        y1.push_back(edge.b.y);
+    }
+
+    void clear()
+    {
+        x0.clear();
+        y0.clear();
+        x1.clear();
+        y1.clear();
+        shapeFirst.clear();
+    }
+
+    // Appending the window's border, it stops the rays that miss every shape.
+    // Its corners start edges too, so they get rays like the shapes' vertices.
+    void addBorder(const float width, const float height)
+    {
+        push(Edge { sf::Vector2f(0, 0),          sf::Vector2f(width, 0) });
+        push(Edge { sf::Vector2f(width, 0),      sf::Vector2f(width, height) });
+        push(Edge { sf::Vector2f(width, height), sf::Vector2f(0, height) });
+        push(Edge { sf::Vector2f(0, height),     sf::Vector2f(0, 0) });
+    }
+
+    // Appending the edges of a new shape
+    void addShape(const sf::CircleShape& shape)
+    {
+        shapeFirst.push_back(static_cast<unsigned int>(size()));
+
+        for(size_t i = 0; i < shape.getPointCount(); i++)
+            push(Edge {});
+
+        updateShape(shapeFirst.size() - 1, shape);
+    }
+
+    // Transforming the points of a shape that changed, its point count stays the same
+    void updateShape(const size_t index, const sf::CircleShape& shape)
+    {
+        const auto& transform = shape.getTransform();
+        const size_t first = shapeFirst[index];
+        const size_t count = shape.getPointCount();
+
+        for(size_t i = 0; i < count; i++)
+        {
+            const auto point = transform.transformPoint(shape.getPoint(i));
+
+            // The point starts this edge and ends the one before it
+            const size_t previous = first + (i + count - 1) % count;
+
+            x0[first + i] = point.x;
+            y0[first + i] = point.y;
+            x1[previous]  = point.x;
+            y1[previous]  = point.y;
+        }
+    }
+};
+// ------------------------------------------------------------------------
+
+// Axis aligned bounding box, empty until a point is added.
+struct Box
+{
+    sf::Vector2f min {  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max() };
+    sf::Vector2f max { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+    void expand(const sf::Vector2f p)
+    {
+        min = sf::Vector2f(std::min(min.x, p.x), std::min(min.y, p.y));
+        max = sf::Vector2f(std::max(max.x, p.x), std::max(max.y, p.y));
+    }
+
+    void expand(const Box& box)
+    {
+        expand(box.min);
+        expand(box.max);
+    }
+};
+// ------------------------------------------------------------------------
+
+// Check if the ray crosses the box, the slab test on the ray's points p1 + t * (p2 - p1) with t in [0, limit].
+// entry receives the t where the ray enters the box.
+static bool rayCrossesBox(const Ray& ray, const Box& box, const float limit = 1, float* entry = nullptr)
+{
+    float tMin = 0, tMax = limit;
+
+    const float origin[2] { ray.p1.x, ray.p1.y };
+    const float dir[2]    { ray.p2.x - ray.p1.x, ray.p2.y - ray.p1.y };
+    const float low[2]    { box.min.x, box.min.y };
+    const float high[2]   { box.max.x, box.max.y };
+
+    for(int axis = 0; axis < 2; axis++)
+    {
+        // Parallel to the slab, it's either always inside it or never
+        if(dir[axis] == 0.f)
+        {
+            if(origin[axis] < low[axis] || origin[axis] > high[axis])
+                return false;
+
+            continue;
+        }
+
+        float t1 = (low[axis] - origin[axis]) / dir[axis];
+        float t2 = (high[axis] - origin[axis]) / dir[axis];
+
+        if(t1 > t2)
+            std::swap(t1, t2);
+
+        tMin = std::max(tMin, t1);
+        tMax = std::min(tMax, t2);
+
+        if(tMin > tMax)
+            return false;
+    }
+
+    if(entry)
+        *entry = tMin;
+
+    return true;
 }
 // ------------------------------------------------------------------------
 
-int main()
+// The closest hit on an edge, for a ray from p1 along d (p2 - p1).
+// Ray: p1 + t * d, edge: a + u * e, they meet at
+//   t = cross(a - p1, e) / cross(d, e)
+//   u = cross(a - p1, d) / cross(d, e)
+// The hit counts when u is in [0, 1] and t in [0, t) of the closest hit so far, which it replaces.
+// The signs are compared before dividing, so a miss costs a few multiplications and no division.
+static inline bool hitEdge(const sf::Vector2f p1, const sf::Vector2f d, const Edge& edge, float& t)
 {
-    // Creates a window with AA
-    sf::ContextSettings settings;
-    settings.antialiasingLevel = 32;
-    sf::RenderWindow window(sf::VideoMode(Width, Height), "Raycast 2D Test", sf::Style::Default, settings);
+    const float ex = edge.b.x - edge.a.x, ey = edge.b.y - edge.a.y;
+    const float ax = edge.a.x - p1.x,     ay = edge.a.y - p1.y;
 
-    // The shapes that will appear on the screen
-    std::vector<sf::CircleShape> shapes;
+    float denominator = d.x * ey - d.y * ex;
+    float tNumerator  = ax * ey - ay * ex;
+    float uNumerator  = ax * d.y - ay * d.x;
 
-    while(window.isOpen())
+    // Parallel, a ray along the edge only touches its end points
+    if(denominator == 0.f)
+        return false;
+
+    if(denominator < 0.f)
     {
-        const auto MousePos = sf::Mouse::getPosition(window);
+        denominator = -denominator;
+        tNumerator  = -tNumerator;
+        uNumerator  = -uNumerator;
+    }
 
-        // Events handling
-        sf::Event event;
-        while(window.pollEvent(event)) 
+    if(tNumerator < 0.f || tNumerator >= t * denominator || uNumerator < 0.f || uNumerator > denominator)
+        return false;
+
+    t = tNumerator / denominator;
+    return true;
+}
+// ------------------------------------------------------------------------
+
+// Instruction set the edge kernels run on, picked at runtime.
+enum class Isa { Scalar, AVX2, AVX512 };
+
+static Isa detectIsa()
+{
+#ifdef RAYCAST_X86_SIMD
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512f"))
+        return Isa::AVX512;
+
+    if(__builtin_cpu_supports("avx2"))
+        return Isa::AVX2;
+#endif
+
+    return Isa::Scalar;
+}
+// ------------------------------------------------------------------------
+
+// The closest hit of a ray from p1 along d on the edges [first, first + count) of the buffer, t is the closest hit so far.
+// The vector kernels test one ray against 8 (AVX2) or 16 (AVX-512) edges at once, every lane keeps its own
+// closest t and they're reduced to one at the end. Lanes past the last edge are loaded as zero length edges,
+// which are parallel to everything and never hit.
+// Epsilon: every lane does the same float operations in the same order as hitEdge(), so both paths find the
+// same t, bit for bit, except when two hits are within an ulp of each other (the scalar loop may keep either).
+// A build that lets the compiler fuse hitEdge()'s multiply-subtracts (-march=native) moves t by up to 1e-6.
+static float closestHitScalar(const sf::Vector2f p1, const sf::Vector2f d, const EdgeBuffer& edges, const size_t first, const size_t count, float t)
+{
+    for(size_t i = first; i < first + count; i++)
+        hitEdge(p1, d, edges.edge(i), t);
+
+    return t;
+}
+
+#ifdef RAYCAST_X86_SIMD
+__attribute__((target("avx2")))
+static float closestHitAvx2(const sf::Vector2f p1, const sf::Vector2f d, const EdgeBuffer& edges, const size_t first, const size_t count, const float t)
+{
+    const __m256 px = _mm256_set1_ps(p1.x), py = _mm256_set1_ps(p1.y);
+    const __m256 dx = _mm256_set1_ps(d.x),  dy = _mm256_set1_ps(d.y);
+    const __m256 zero = _mm256_setzero_ps(), sign = _mm256_set1_ps(-0.f), none = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 best = _mm256_set1_ps(t);
+
+    for(size_t i = 0; i < count; i += 8)
+    {
+        const __m256i load = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(std::min<size_t>(count - i, 8))), lane);
+
+        const __m256 x0 = _mm256_maskload_ps(edges.x0.data() + first + i, load);
+        const __m256 y0 = _mm256_maskload_ps(edges.y0.data() + first + i, load);
+        const __m256 x1 = _mm256_maskload_ps(edges.x1.data() + first + i, load);
+        const __m256 y1 = _mm256_maskload_ps(edges.y1.data() + first + i, load);
+
+        const __m256 ex = _mm256_sub_ps(x1, x0), ey = _mm256_sub_ps(y1, y0);
+        const __m256 ax = _mm256_sub_ps(x0, px), ay = _mm256_sub_ps(y0, py);
+
+        __m256 denominator = _mm256_sub_ps(_mm256_mul_ps(dx, ey), _mm256_mul_ps(dy, ex));
+        __m256 tNumerator  = _mm256_sub_ps(_mm256_mul_ps(ax, ey), _mm256_mul_ps(ay, ex));
+        __m256 uNumerator  = _mm256_sub_ps(_mm256_mul_ps(ax, dy), _mm256_mul_ps(ay, dx));
+
+        // Flipping the signs of the lanes with a negative denominator
+        const __m256 flip = _mm256_and_ps(denominator, sign);
+        denominator = _mm256_xor_ps(denominator, flip);
+        tNumerator  = _mm256_xor_ps(tNumerator, flip);
+        uNumerator  = _mm256_xor_ps(uNumerator, flip);
+
+        __m256 hit = _mm256_cmp_ps(denominator, zero, _CMP_NEQ_OQ);
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(tNumerator, zero, _CMP_GE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(tNumerator, _mm256_mul_ps(best, denominator), _CMP_LT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(uNumerator, zero, _CMP_GE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(uNumerator, denominator, _CMP_LE_OQ));
+
+        best = _mm256_min_ps(best, _mm256_blendv_ps(none, _mm256_div_ps(tNumerator, denominator), hit));
+    }
+
+    __m128 closest = _mm_min_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+    closest = _mm_min_ps(closest, _mm_movehl_ps(closest, closest));
+    closest = _mm_min_ss(closest, _mm_shuffle_ps(closest, closest, 1));
+
+    return _mm_cvtss_f32(closest);
+}
+
+// GCC enables fma together with avx512f, so contraction is turned off explicitly
+// to keep the products rounded the same way as in hitEdge().
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+__attribute__((target("avx512f")))
+static float closestHitAvx512(const sf::Vector2f p1, const sf::Vector2f d, const EdgeBuffer& edges, const size_t first, const size_t count, const float t)
+{
+    const __m512 px = _mm512_set1_ps(p1.x), py = _mm512_set1_ps(p1.y);
+    const __m512 dx = _mm512_set1_ps(d.x),  dy = _mm512_set1_ps(d.y);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i sign = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+
+    __m512 best = _mm512_set1_ps(t);
+
+    for(size_t i = 0; i < count; i += 16)
+    {
+        const __mmask16 load = count - i >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << (count - i)) - 1);
+
+        const __m512 x0 = _mm512_maskz_loadu_ps(load, edges.x0.data() + first + i);
+        const __m512 y0 = _mm512_maskz_loadu_ps(load, edges.y0.data() + first + i);
+        const __m512 x1 = _mm512_maskz_loadu_ps(load, edges.x1.data() + first + i);
+        const __m512 y1 = _mm512_maskz_loadu_ps(load, edges.y1.data() + first + i);
+
+        const __m512 ex = _mm512_sub_ps(x1, x0), ey = _mm512_sub_ps(y1, y0);
+        const __m512 ax = _mm512_sub_ps(x0, px), ay = _mm512_sub_ps(y0, py);
+
+        __m512 denominator = _mm512_sub_ps(_mm512_mul_ps(dx, ey), _mm512_mul_ps(dy, ex));
+        __m512 tNumerator  = _mm512_sub_ps(_mm512_mul_ps(ax, ey), _mm512_mul_ps(ay, ex));
+        __m512 uNumerator  = _mm512_sub_ps(_mm512_mul_ps(ax, dy), _mm512_mul_ps(ay, dx));
+
+        // Flipping the signs of the lanes with a negative denominator, avx512f only has integer xor
+        const __m512i flip = _mm512_and_epi32(_mm512_castps_si512(denominator), sign);
+        denominator = _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(denominator), flip));
+        tNumerator  = _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(tNumerator), flip));
+        uNumerator  = _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(uNumerator), flip));
+
+        __mmask16 hit = _mm512_mask_cmp_ps_mask(load, denominator, zero, _CMP_NEQ_OQ);
+        hit = _mm512_mask_cmp_ps_mask(hit, tNumerator, zero, _CMP_GE_OQ);
+        hit = _mm512_mask_cmp_ps_mask(hit, tNumerator, _mm512_mul_ps(best, denominator), _CMP_LT_OQ);
+        hit = _mm512_mask_cmp_ps_mask(hit, uNumerator, zero, _CMP_GE_OQ);
+        hit = _mm512_mask_cmp_ps_mask(hit, uNumerator, denominator, _CMP_LE_OQ);
+
+        best = _mm512_mask_min_ps(best, hit, best, _mm512_maskz_div_ps(hit, tNumerator, denominator));
+    }
+
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, best);
+
+    return *std::min_element(lanes, lanes + 16);
+}
+
+#pragma GCC pop_options
+#endif
+
+static float closestHitEdges(const sf::Vector2f p1, const sf::Vector2f d, const EdgeBuffer& edges, const size_t first, const size_t count, const float t, const Isa isa)
+{
+#ifdef RAYCAST_X86_SIMD
+    if(isa == Isa::AVX512)
+        return closestHitAvx512(p1, d, edges, first, count, t);
+
+    if(isa == Isa::AVX2)
+        return closestHitAvx2(p1, d, edges, first, count, t);
+#endif
+
+    return closestHitScalar(p1, d, edges, first, count, t);
+}
+
+// No edge, for a ray that got to its end without a hit
+constexpr unsigned int NoEdge = ~0u;
+
+// Which of the edges [first, first + count) the ray hits at t, the closest hit the kernels found there.
+// Only hitEdge() runs again, it finds the kernels' t but for fused operations, so the edge with the nearest t is the one.
+static unsigned int edgeHitAt(const sf::Vector2f p1, const sf::Vector2f d, const EdgeBuffer& edges, const size_t first, const size_t count, const float t)
+{
+    unsigned int hit = NoEdge;
+    float nearest = std::numeric_limits<float>::max();
+
+    if(t >= 1)
+        return hit;
+
+    for(size_t i = first; i < first + count; i++)
+    {
+        float edgeT = 1;
+
+        if(hitEdge(p1, d, edges.edge(i), edgeT) && std::fabs(edgeT - t) < nearest)
         {
-            // When exit button pressed then actually exit.
-            if(event.type == sf::Event::Closed)
-                window.close();
+            nearest = std::fabs(edgeT - t);
+            hit = static_cast<unsigned int>(i);
+        }
+    }
 
-            // When mouse pressed create a shape
-            if(event.type == sf::Event::MouseButtonPressed)
-                shapes.push_back(createShape(MousePos));
+    return hit;
+}
+// ------------------------------------------------------------------------
+
+// Bounding volume hierarchy over the edges of all shapes, so a ray only tests
+// the edges in the boxes it crosses instead of every edge in the scene.
+// Nodes are stored depth first: an inner node's left child comes right after it,
+// and a leaf owns a run of up to LeafEdges edges in the tree's own copy of the edges, stored in leaf order.
+// A leaf is one group of the AVX-512 edge kernel (two of the AVX2 one).
+struct EdgeBVH
+{
+    static constexpr unsigned int LeafEdges = 16;
+
+    struct Node
+    {
+        Box box;
+        unsigned int first = 0, count = 0; // leaf: its edges
+        unsigned int right = 0;            // inner node (count == 0): its right child
+    };
+
+    // Refitting may loosen the boxes up to this many times their total perimeter right after the build
+    static constexpr float RebuildCost = 1.1f;
+
+    EdgeBuffer edges;
+    std::vector<Node> nodes;
+
+    // Which of the scene's edges every edge of the tree is
+    std::vector<unsigned int> order;
+
+    // The kernel the leaves are tested with
+    Isa isa = detectIsa();
+
+    // Building the tree top down, every node is split at the median edge
+    // along the longest axis of its edges' centers.
+    void build(const EdgeBuffer& scene)
+    {
+        order.resize(scene.size());
+        std::iota(order.begin(), order.end(), 0u);
+
+        nodes.clear();
+        if(!order.empty())
+            buildNode(scene, 0, static_cast<unsigned int>(order.size()));
+
+        edges.clear();
+        for(const unsigned int i : order)
+            edges.push(scene.edge(i));
+
+        builtCost = cost();
+    }
+
+    // Moving the tree's edges to where the scene's edges are now and fitting the boxes to them again,
+    // the scene has to have the same edges the tree was built from.
+    // Children are stored after their parent, so walking the nodes backwards fits every child before its parent.
+    // Returns false once the boxes got so loose that building the tree again pays off.
+    bool refit(const EdgeBuffer& scene)
+    {
+        for(size_t i = 0; i < order.size(); i++)
+        {
+            edges.x0[i] = scene.x0[order[i]];
+            edges.y0[i] = scene.y0[order[i]];
+            edges.x1[i] = scene.x1[order[i]];
+            edges.y1[i] = scene.y1[order[i]];
         }
 
-        // All of the rays that have been projected every frame
-        std::vector<Ray> rays;
-
-        // Creates rays for the window coordinates
-        Ray windowPoints[4];
-        // Top Left Corner
-        windowPoints[0].p1 = vector_cast<float>(MousePos);
-        windowPoints[0].p2 = sf::Vector2f(0, 0);
-        // Top Right Corner
-        windowPoints[1].p1 = vector_cast<float>(MousePos);
-        windowPoints[1].p2 = sf::Vector2f(Width, 0);
-        // Bottom Left Corner
-        windowPoints[2].p1 = vector_cast<float>(MousePos);
-        windowPoints[2].p2 = sf::Vector2f(0, Height);
-        // Bottom Right Corner
-        windowPoints[3].p1 = vector_cast<float>(MousePos);
-        windowPoints[3].p2 = sf::Vector2f(Width, Height);
-
-        // Move all of the rays to the vector
-        rays.push_back(std::move(windowPoints[0]));
-        rays.push_back(std::move(windowPoints[1]));
-        rays.push_back(std::move(windowPoints[2]));
-        rays.push_back(std::move(windowPoints[3]));
-
-        // Looping over all of the points in all shapes
-        for(auto& shape : shapes)
+        for(size_t index = nodes.size(); index-- > 0;)
+        {
+            Node& node = nodes[index];
+            Box box;
+
+            if(node.count > 0)
+            {
+                for(unsigned int i = node.first; i < node.first + node.count; i++)
+                {
+                    box.expand(sf::Vector2f(edges.x0[i], edges.y0[i]));
+                    box.expand(sf::Vector2f(edges.x1[i], edges.y1[i]));
+                }
+            }
+            else
+            {
+                box = nodes[index + 1].box;
+                box.expand(nodes[node.right].box);
+            }
+
+            node.box = box;
+        }
+
+        return cost() <= RebuildCost * builtCost;
+    }
+
+    // The closest hit along the ray as the fraction t of the way from p1 to p2, 1 when nothing is in the way.
+    // Nodes are visited nearest first, and skipped once they start behind the closest hit so far,
+    // so the walk ends as soon as t can't improve.
+    // tested counts the edges in the leaves that were tested, edge is set to the scene's index of the edge hit (or NoEdge).
+    float closestHit(const Ray& ray, size_t* tested = nullptr, unsigned int* edge = nullptr) const
+    {
+        float t = 1;
+
+        if(edge)
+            *edge = NoEdge;
+
+        if(nodes.empty())
+            return t;
+
+        const sf::Vector2f d(ray.p2.x - ray.p1.x, ray.p2.y - ray.p1.y);
+
+        // Nodes to visit with the t where the ray enters them
+        std::pair<unsigned int, float> stack[64];
+        unsigned int size = 0;
+
+        float entry;
+        if(rayCrossesBox(ray, nodes[0].box, t, &entry))
+            stack[size++] = { 0, entry };
+
+        // The leaf of the closest hit so far
+        const Node* hitLeaf = nullptr;
+
+        while(size > 0)
         {
-            for(size_t i = 0; i < shape.getPointCount(); i++)
+            const auto [index, nodeEntry] = stack[--size];
+            const Node& node = nodes[index];
+
+            if(nodeEntry >= t)
+                continue;
+
+            if(node.count > 0)
             {
-                Ray ray;
+                const float leafT = closestHitEdges(ray.p1, d, edges, node.first, node.count, t, isa);
+
+                if(leafT < t)
+                    hitLeaf = &node;
+
+                t = leafT;
+
+                if(tested)
+                    *tested += node.count;
+
+                continue;
+            }
 
-                // Starting position of the Ray is where the mouse is
-                ray.p1 = vector_cast<float>(MousePos);
+            // The nearer child is pushed last, so it's visited first
+            float leftEntry, rightEntry;
+            const bool left  = rayCrossesBox(ray, nodes[index + 1].box, t, &leftEntry);
+            const bool right = rayCrossesBox(ray, nodes[node.right].box, t, &rightEntry);
 
-                // Ending position of the ray is where the shapes point are
-                const auto point = shape.getTransform().transformPoint(shape.getPoint(i));
-                ray.p2 = point;
+            if(left && right && leftEntry < rightEntry)
+            {
+                stack[size++] = { node.right, rightEntry };
+                stack[size++] = { index + 1, leftEntry };
+            }
+            else
+            {
+                if(left)
+                    stack[size++] = { index + 1, leftEntry };
 
-                rays.push_back(ray);
+                if(right)
+                    stack[size++] = { node.right, rightEntry };
             }
         }
 
-        // Looping over all of the points in all shapes to check for intersection
-        for(auto& shape : shapes)
+        if(edge && hitLeaf)
         {
-            for(size_t i = 0; i < shape.getPointCount(); i++)
-            {
-                // Current Point
-                const auto current = shape.getTransform().transformPoint(shape.getPoint(i));
+            const unsigned int hit = edgeHitAt(ray.p1, d, edges, hitLeaf->first, hitLeaf->count, t);
 
-                // Next Point
-                const auto next = shape.getTransform().transformPoint(shape.getPoint((i + 1) % shape.getPointCount()));
+            if(hit != NoEdge)
+                *edge = order[hit];
+        }
 
-                for(auto& ray : rays)
-                {
-                    // Check intersection between two lines
-                    if(intersection(current, next, ray.p1, ray.p2))
-                    {
-                        // Get the point of intersection
-                        const auto point = pointIntersection(current, next, ray.p1, ray.p2);
+        return t;
+    }
 
-                        // Calculates the line length to the point
-                        const float dist = distance(point, ray.p1);
+    // Calling visit with the index of every edge in every leaf the ray crosses.
+    // The ray is read again at every node, so shortening it in visit prunes the rest of the walk.
+    template<typename Visit>
+    void forEachCandidate(const Ray& ray, Visit&& visit) const
+    {
+        if(nodes.empty())
+            return;
 
-                        // Update the length to point of intersection
-                        setRayLength(ray, dist);
-                    }     
-                }
+        // The tree is balanced, its depth is about log2 of the edge count
+        unsigned int stack[64];
+        unsigned int size = 0;
+        stack[size++] = 0;
+
+        while(size > 0)
+        {
+            const Node& node = nodes[stack[--size]];
+
+            if(!rayCrossesBox(ray, node.box))
+                continue;
+
+            if(node.count > 0)
+            {
+                for(unsigned int i = node.first; i < node.first + node.count; i++)
+                    visit(i);
+
+                continue;
             }
+
+            stack[size++] = node.right;
+            stack[size++] = static_cast<unsigned int>(&node - nodes.data()) + 1;
         }
+    }
 
-        // Clears GPU Buffer
-        window.clear(sf::Color::White);
+private:
+    // The total perimeter of the boxes, about how many boxes a ray crosses
+    float builtCost = 0;
 
-        // Shape Draws
-        for(auto& shape : shapes)
-            window.draw(shape);
+    float cost() const
+    {
+        float total = 0;
+        for(const auto& node : nodes)
+            total += 2 * (node.box.max.x - node.box.min.x + node.box.max.y - node.box.min.y);
+
+        return total;
+    }
+
+    static sf::Vector2f center(const Edge& edge) { return sf::Vector2f((edge.a.x + edge.b.x) / 2, (edge.a.y + edge.b.y) / 2); }
+
+    unsigned int buildNode(const EdgeBuffer& scene, unsigned int first, unsigned int count)
+    {
+        const unsigned int index = static_cast<unsigned int>(nodes.size());
+        nodes.emplace_back();
+
+        Box box, centers;
+        for(unsigned int i = first; i < first + count; i++)
+        {
+            const Edge edge = scene.edge(order[i]);
+
+            box.expand(edge.a);
+            box.expand(edge.b);
+            centers.expand(center(edge));
+        }
+
+        nodes[index].box = box;
 
-        // Ray Draws
-        for(auto& ray : rays)
+        if(count <= LeafEdges)
         {
-            sf::Vertex vertex[2] { ray.p1, ray.p2 };
-            vertex->color = sf::Color::Red;
-            window.draw(vertex, 2, sf::Lines);
+            nodes[index].first = first;
+            nodes[index].count = count;
+            return index;
         }
 
+        // Splitting the longest axis at the median
+        const bool splitX = centers.max.x - centers.min.x >= centers.max.y - centers.min.y;
+        const unsigned int half = count / 2;
+
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+            [&scene, splitX](const unsigned int e1, const unsigned int e2) {
+                const sf::Vector2f c1 = center(scene.edge(e1)), c2 = center(scene.edge(e2));
+                return splitX ? c1.x < c2.x : c1.y < c2.y;
+            });
+
+        buildNode(scene, first, half);
+        const unsigned int right = buildNode(scene, first + half, count - half);
+
+        // nodes may have grown, so the node is looked up again
+        nodes[index].right = right;
+        return index;
+    }
+};
+// ------------------------------------------------------------------------
+
+// 2D cross product (the z of the 3D one), positive when b is counterclockwise from a.
+static inline double cross(const double ax, const double ay, const double bx, const double by) { return ax * by - ay * bx; }
+
+// A point where two of the scene's edges cross, first < second are their indices in the scene.
+struct Crossing
+{
+    unsigned int first, second;
+    sf::Vector2f point;
+};
+
+// How close a crossing has to be to a vertex to be put on it, far more than the rounding of the crossing point
+constexpr float VertexSnap = 1e-3f;
+
+// Every point where two edges of the scene cross, shapes are allowed to overlap (and to leave the window).
+// Every edge finds the edges it crosses through the scene's BVH, which has to be up to date with the edges.
+// The crossings are sorted by their edges, so they come out in the same order whatever order the BVH has the edges in.
+static std::vector<Crossing> crossingEdges(const EdgeBVH& bvh)
+{
+    std::vector<Crossing> crossings;
+
+    for(size_t i = 0; i < bvh.edges.size(); i++)
+    {
+        const Edge edge = bvh.edges.edge(i);
+
+        bvh.forEachCandidate(Ray { edge.a, edge.b }, [&](const size_t j) {
+            const Edge other = bvh.edges.edge(j);
+
+            // Neighbouring edges of a shape only touch at their shared point
+            if(j <= i || edge.a == other.a || edge.a == other.b || edge.b == other.a || edge.b == other.b)
+                return;
+
+            if(!intersection(edge.a, edge.b, other.a, other.b))
+                return;
+
+            // An edge through another shape's vertex crosses both of its edges there, rounded apart.
+            // Crossings that close to a vertex are put on it, so every edge meets there at the very same point.
+            sf::Vector2f point = pointIntersection(edge.a, edge.b, other.a, other.b);
+
+            for(const auto vertex : { edge.a, edge.b, other.a, other.b })
+                if(distance(point, vertex) < VertexSnap)
+                    point = vertex;
+
+            const unsigned int e1 = bvh.order[i], e2 = bvh.order[j];
+            crossings.push_back(Crossing { std::min(e1, e2), std::max(e1, e2), point });
+        });
+    }
+
+    std::sort(crossings.begin(), crossings.end(), [](const Crossing& c1, const Crossing& c2) {
+        return std::tie(c1.second, c1.first) < std::tie(c2.second, c2.first);
+    });
+
+    return crossings;
+}
+
+// Splitting the edges at their crossings, the sweep needs segments that only touch at their end points.
+// Every crossing cuts, however close it is to a vertex or another cut, a piece left out would cross the other edge's pieces.
+static std::vector<Edge> splitCrossingEdges(const EdgeBuffer& edges, const std::vector<Crossing>& crossings)
+{
+    // Where every edge is cut, by the distance from its first point, and the crossing that cuts it there
+    std::vector<std::vector<std::pair<float, unsigned int>>> cuts(edges.size());
+
+    for(unsigned int c = 0; c < crossings.size(); c++)
+    {
+        const Crossing& crossing = crossings[c];
+        cuts[crossing.first].emplace_back(distance(edges.edge(crossing.first).a, crossing.point), c);
+        cuts[crossing.second].emplace_back(distance(edges.edge(crossing.second).a, crossing.point), c);
+    }
+
+    // Three edges through one point cross three times there, rounded apart, which would leave pieces too short
+    // to have a direction. Crossings closer than VertexSnap along an edge are joined into one point, the one
+    // on a vertex if there is one. Both edges are cut at the very same point, so their pieces meet exactly.
+    std::vector<unsigned int> joined(crossings.size());
+    std::iota(joined.begin(), joined.end(), 0u);
+
+    auto root = [&](unsigned int c) {
+        while(joined[c] != c)
+            c = joined[c] = joined[joined[c]];
+        return c;
+    };
+
+    for(auto& edgeCuts : cuts)
+    {
+        std::sort(edgeCuts.begin(), edgeCuts.end());
+
+        for(size_t k = 1; k < edgeCuts.size(); k++)
+            if(edgeCuts[k].first - edgeCuts[k - 1].first < VertexSnap)
+            {
+                const unsigned int r1 = root(edgeCuts[k - 1].second), r2 = root(edgeCuts[k].second);
+                joined[std::max(r1, r2)] = std::min(r1, r2);
+            }
+    }
+
+    std::vector<sf::Vector2f> points(crossings.size());
+
+    for(unsigned int c = 0; c < crossings.size(); c++)
+        if(root(c) == c)
+            points[c] = crossings[c].point;
+
+    for(unsigned int c = 0; c < crossings.size(); c++)
+    {
+        const Edge e1 = edges.edge(crossings[c].first), e2 = edges.edge(crossings[c].second);
+        const sf::Vector2f point = crossings[c].point;
+
+        if(point == e1.a || point == e1.b || point == e2.a || point == e2.b)
+            points[root(c)] = point;
+    }
+
+    std::vector<Edge> pieces;
+
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        const Edge edge = edges.edge(i);
+
+        sf::Vector2f start = edge.a;
+        for(const auto& cut : cuts[i])
+        {
+            const sf::Vector2f point = points[root(cut.second)];
+
+            // A cut on a vertex or on the last cut would leave an empty piece
+            if(point != start && point != edge.b)
+            {
+                pieces.push_back(Edge { start, point });
+                start = point;
+            }
+        }
+
+        pieces.push_back(Edge { start, edge.b });
+    }
+
+    return pieces;
+}
+// ------------------------------------------------------------------------
+
+// The visibility polygon of origin, the region it sees inside the window, by an angular sweep in O(n log n).
+// Edge end points are sorted by angle around origin and swept counterclockwise. The segments the sweep
+// ray crosses are kept in a balanced tree (std::set) in their order along the ray, so the
+// nearest one is always the first. Whenever the nearest segment changes the polygon gets two corners:
+// where the ray leaves the old nearest segment and where it lands on the new one.
+// The order of two segments along the ray only stays the same while they can't cross, so the edges are the scene's
+// edges split by splitCrossingEdges(), shared by every origin. They include the window's border, which closes the polygon.
+static std::vector<sf::Vector2f> visibilityPolygon(const sf::Vector2f origin, const std::vector<Edge>& edges)
+{
+    // Relative to origin, b is counterclockwise from a. Reach is how far from origin the segment's line passes.
+    struct Segment { double ax, ay, bx, by, length, reach; };
+
+    std::vector<Segment> segments;
+    segments.reserve(edges.size());
+
+    for(const auto& edge : edges)
+    {
+        Segment segment { edge.a.x - origin.x, edge.a.y - origin.y, edge.b.x - origin.x, edge.b.y - origin.y, 0, 0 };
+        const double turn = cross(segment.ax, segment.ay, segment.bx, segment.by);
+
+        segment.length = std::hypot(segment.bx - segment.ax, segment.by - segment.ay);
+        segment.reach  = std::fabs(turn) / segment.length;
+
+        // Seen edge on, the segment hides nothing. Within VertexSnap of the origin its line is as good as through it,
+        // which side of the line the origin is on would be rounding.
+        if(!(segment.reach > VertexSnap))
+            continue;
+
+        if(turn < 0)
+        {
+            std::swap(segment.ax, segment.bx);
+            std::swap(segment.ay, segment.by);
+        }
+
+        segments.push_back(segment);
+    }
+
+    // The sweep ray's direction
+    double dirX = -1, dirY = 0;
+
+    // Distance along the sweep ray to a segment it crosses, in units of the direction's length
+    auto along = [&](const Segment& s) {
+        const double ex = s.bx - s.ax, ey = s.by - s.ay;
+        const double denominator = cross(dirX, dirY, ex, ey);
+
+        return denominator == 0 ? std::numeric_limits<double>::max() : cross(s.ax, s.ay, ex, ey) / denominator;
+    };
+
+    // Where s2 lies from the line through s1: -1 on the origin's side, 1 behind it, 0 on both sides or on the line.
+    // An end closer to the line than VertexSnap is on it: ends s2 shares with s1, and vertices that touch
+    // s1 but were rounded across it. The other end gives the side.
+    auto sideOf = [](const Segment& s1, const Segment& s2) {
+        const double ex = s1.bx - s1.ax, ey = s1.by - s1.ay;
+        const double onLine = VertexSnap * s1.length;
+
+        auto side = [&](const double x, const double y) {
+            const double c = cross(ex, ey, x - s1.ax, y - s1.ay);
+            return std::fabs(c) <= onLine ? 0.0 : c;
+        };
+
+        const double first = side(s2.ax, s2.ay), second = side(s2.bx, s2.by);
+        const double origin = cross(ex, ey, -s1.ax, -s1.ay);
+
+        if((first > 0 && second < 0) || (first < 0 && second > 0) || (first == 0 && second == 0))
+            return 0;
+
+        return (first + second > 0) == (origin > 0) ? -1 : 1;
+    };
+
+    // Closer along the sweep ray. The pieces only touch at their ends, so of two pieces under the ray one lies on
+    // a single side of the other's line, and that side is their order along every ray that crosses both.
+    // The order is a property of the two pieces alone, it can't change between events, so it's the same for every
+    // pair in the tree whenever they're compared.
+    // The piece whose line passes farther from the origin is always asked first: the origin's side of a short piece
+    // that points at it is the least certain. Swapping the two asks the same question, so gives the opposite answer.
+    auto closer = [&](const unsigned int i, const unsigned int j) {
+        if(i == j)
+            return false;
+
+        const bool iFirst = std::tie(segments[i].reach, j) > std::tie(segments[j].reach, i);
+        const unsigned int first = iFirst ? i : j, second = iFirst ? j : i;
+
+        int order = sideOf(segments[first], segments[second]);     // -1: second is closer
+        if(order == 0)
+            order = -sideOf(segments[second], segments[first]);
+
+        // Pieces on one line: where they overlap they're hit at the same point, elsewhere the ray runs along
+        // the line and meets the nearer piece first
+        if(order == 0)
+        {
+            auto midDistance = [](const Segment& s) { return std::hypot(s.ax + s.bx, s.ay + s.by); };
+            const double dFirst = midDistance(segments[first]), dSecond = midDistance(segments[second]);
+
+            if(dFirst == dSecond)
+                return i < j;
+
+            order = dSecond < dFirst ? -1 : 1;
+        }
+
+        return (order < 0) == (i == second);
+    };
+
+    std::set<unsigned int, decltype(closer)> active(closer);
+    std::vector<std::set<unsigned int, decltype(closer)>::iterator> inTree(segments.size(), active.end());
+
+    // Every end point is an event, the start of a segment (a) adds it, the end (b) removes it
+    struct Event { double angle; unsigned int segment; bool start; };
+    std::vector<Event> events;
+    events.reserve(segments.size() * 2);
+
+    for(unsigned int i = 0; i < segments.size(); i++)
+    {
+        const Segment& s = segments[i];
+        const double startAngle = atan2(s.ay, s.ax), endAngle = atan2(s.by, s.bx);
+
+        events.push_back(Event { startAngle, i, true });
+        events.push_back(Event { endAngle, i, false });
+
+        // Segments crossing the ray at -pi (pointing left) are already under the sweep when it starts
+        if(startAngle > endAngle)
+            inTree[i] = active.insert(i).first;
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event& e1, const Event& e2) { return e1.angle < e2.angle; });
+
+    std::vector<sf::Vector2f> polygon;
+
+    // Where the sweep ray meets the segment
+    auto hit = [&](const unsigned int i) {
+        const double t = along(segments[i]);
+        return sf::Vector2f(static_cast<float>(origin.x + dirX * t), static_cast<float>(origin.y + dirY * t));
+    };
+
+    if(active.empty())
+        return polygon;
+
+    polygon.push_back(hit(*active.begin()));
+
+    for(size_t first = 0; first < events.size();)
+    {
+        // All the events at the same angle are handled together
+        size_t last = first;
+        while(last < events.size() && events[last].angle == events[first].angle)
+            last++;
+
+        const Segment& s = segments[events[first].segment];
+        const bool startPoint = events[first].start;
+        dirX = startPoint ? s.ax : s.bx;
+        dirY = startPoint ? s.ay : s.by;
+
+        const unsigned int nearest = active.empty() ? ~0u : *active.begin();
+
+        // Removing first, the segments that end here don't need to be compared with the ones that start here
+        for(size_t e = first; e < last; e++)
+            if(!events[e].start && inTree[events[e].segment] != active.end())
+            {
+                active.erase(inTree[events[e].segment]);
+                inTree[events[e].segment] = active.end();
+            }
+
+        for(size_t e = first; e < last; e++)
+            if(events[e].start && inTree[events[e].segment] == active.end())
+                inTree[events[e].segment] = active.insert(events[e].segment).first;
+
+        if(!active.empty() && *active.begin() != nearest)
+        {
+            if(nearest != ~0u)
+                polygon.push_back(hit(nearest));
+
+            polygon.push_back(hit(*active.begin()));
+        }
+
+        first = last;
+    }
+
+    return polygon;
+}
+// ------------------------------------------------------------------------
+
+// A pool of threads that cast the rays of a frame together.
+// The rays are handed out in chunks through an atomic counter, and every ray writes its hit into
+// its own slot of a buffer sized before the cast, so the workers never wait on each other while casting.
+// The thread that calls run() takes chunks too.
+class CastPool
+{
+public:
+    using Job = std::function<void(size_t first, size_t count)>;
+
+    static constexpr size_t Chunk = 256;
+
+    explicit CastPool(unsigned int threads)
+    {
+        for(unsigned int i = 1; i < threads; i++)
+            workers.emplace_back(&CastPool::worker, this);
+    }
+
+    ~CastPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for(auto& thread : workers)
+            thread.join();
+    }
+
+    CastPool(const CastPool&) = delete;
+    CastPool& operator=(const CastPool&) = delete;
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    // Runs the job on [0, count) in chunks and blocks until all of them are done.
+    void run(const size_t count, const Job& job)
+    {
+        if(count == 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            current = &job;
+            total   = count;
+            next    = 0;
+            working = static_cast<unsigned int>(workers.size());
+            generation++;
+        }
+
+        wake.notify_all();
+        work(job, count);
+
+        // Every worker finishes a run before the next one can start, so none of them misses one
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return working == 0; });
+        current = nullptr;
+    }
+
+private:
+    void work(const Job& job, const size_t count)
+    {
+        for(size_t first = next.fetch_add(Chunk); first < count; first = next.fetch_add(Chunk))
+            job(first, std::min(Chunk, count - first));
+    }
+
+    void worker()
+    {
+        unsigned long long seen = 0;
+
+        while(true)
+        {
+            const Job* job;
+            size_t count;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+
+                if(stopping)
+                    return;
+
+                seen  = generation;
+                job   = current;
+                count = total;
+            }
+
+            work(*job, count);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                working--;
+            }
+
+            done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const Job* current = nullptr;
+    size_t total = 0;
+    std::atomic<size_t> next { 0 };
+    unsigned long long generation = 0;
+    unsigned int working = 0;
+    bool stopping = false;
+};
+// ------------------------------------------------------------------------
+
+// A number that grows with the angle of (x, y) the way atan2 does, from 0 to 4 around the circle, without any trig.
+// It's the distance walked counterclockwise from (1, 0) on the diamond |x| + |y| = 1.
+static inline float pseudoAngle(const float x, const float y)
+{
+    const float p = x / (std::fabs(x) + std::fabs(y));
+    return y < 0 ? 3 + p : 1 - p;
+}
+// ------------------------------------------------------------------------
+
+// The rays that outline the light polygon of origin at a corner: one to the corner, which stops there,
+// and two that pass it LightEpsilon radians to either side and go on to whatever is behind it.
+// The side rays are long enough to leave the window, where the border stops them.
+static constexpr float LightEpsilon = 1e-4f;
+
+static void aimRays(const sf::Vector2f origin, const sf::Vector2f corner, std::vector<Ray>& rays)
+{
+    const float reach = Width + Height;
+
+    const sf::Vector2f d = corner - origin;
+    const float length = sqrtf(d.x * d.x + d.y * d.y);
+
+    // The origin is on the corner, there's no direction to pass it in
+    if(length == 0.f)
+        return;
+
+    // Turning d by a tiny angle only adds a tiny perpendicular part
+    const float scale = reach / length;
+    const sf::Vector2f side(-d.y * LightEpsilon, d.x * LightEpsilon);
+
+    rays.push_back(Ray { origin, corner });
+    rays.push_back(Ray { origin, origin + (d - side) * scale });
+    rays.push_back(Ray { origin, origin + (d + side) * scale });
+}
+
+// The rays to the vertices of edge firstEdge on, appended to rays, so the rays of many lights go through one cast.
+// The other corners of the light polygon, where two edges cross, are only known once these are cast (lightCorners()).
+static void lightRays(const sf::Vector2f origin, const EdgeBuffer& edges, std::vector<Ray>& rays, const size_t firstEdge = 0)
+{
+    for(size_t i = firstEdge; i < edges.size(); i++)
+        aimRays(origin, sf::Vector2f(edges.x0[i], edges.y0[i]), rays);
+}
+// ------------------------------------------------------------------------
+
+// The rays of all the lights and their hits, kept from frame to frame so only what changed is cast again.
+// Light k's rays are [firstRay[k], firstRay[k + 1]), edges are the scene's edges they hit (NoEdge when none).
+struct LightRays
+{
+    std::vector<Ray> rays;
+    std::vector<float> hits;
+    std::vector<unsigned int> edges;
+    std::vector<size_t> firstRay;
+};
+
+// The rays to the corners between the cast rays [first, last) of one light, appended to rays.
+// Between two neighbouring rays that hit different edges, with no vertex between them, the nearest edge changes
+// where the two cross. When another edge is nearer still, the rays to that point hit it, and the corners
+// on either side of it are found the next time around.
+// So only the crossings on the light polygon get rays, the ones buried in shapes (most of them in a crowded scene) don't.
+static void lightCorners(const sf::Vector2f origin, const EdgeBuffer& edges, const LightRays& cast, const size_t first, const size_t last,
+                         std::vector<Ray>& rays)
+{
+    if(last - first < 2)
+        return;
+
+    std::vector<std::pair<float, unsigned int>> order;
+    order.reserve(last - first);
+
+    for(size_t i = first; i < last; i++)
+        order.emplace_back(pseudoAngle(cast.rays[i].p2.x - origin.x, cast.rays[i].p2.y - origin.y), static_cast<unsigned int>(i));
+
+    std::sort(order.begin(), order.end());
+
+    for(size_t j = 0; j < order.size(); j++)
+    {
+        const auto [angle1, i1] = order[j];
+        auto [angle2, i2] = order[(j + 1) % order.size()];
+
+        // The last one's neighbour is the first one, around the circle
+        if(j + 1 == order.size())
+            angle2 += 4;
+
+        const unsigned int e1 = cast.edges[i1], e2 = cast.edges[i2];
+
+        if(e1 == NoEdge || e2 == NoEdge || e1 == e2)
+            continue;
+
+        const Edge edge1 = edges.edge(e1), edge2 = edges.edge(e2);
+
+        if(!intersection(edge1.a, edge1.b, edge2.a, edge2.b))
+            continue;
+
+        const sf::Vector2f corner = pointIntersection(edge1.a, edge1.b, edge2.a, edge2.b);
+        float angle = pseudoAngle(corner.x - origin.x, corner.y - origin.y);
+
+        if(angle < angle1)
+            angle += 4;
+
+        // Strictly between, a corner that already has its rays is on one of them
+        if(angle > angle1 && angle < angle2)
+            aimRays(origin, corner, rays);
+    }
+}
+
+// Corners behind corners take another round of lightCorners(), this many at most
+constexpr unsigned int CornerRounds = 8;
+
+// Building the light polygon out of the cast rays [first, last) of one light,
+// their hits sorted by angle around the origin make one triangle fan.
+static void lightPolygon(const sf::Vector2f origin, const std::vector<Ray>& rays, const std::vector<float>& hits,
+                         const size_t first, const size_t last, const sf::Color color, sf::VertexArray& fan)
+{
+    std::vector<std::pair<float, unsigned int>> order;
+    order.reserve(last - first);
+
+    for(size_t i = first; i < last; i++)
+        order.emplace_back(pseudoAngle(rays[i].p2.x - rays[i].p1.x, rays[i].p2.y - rays[i].p1.y), static_cast<unsigned int>(i));
+
+    std::sort(order.begin(), order.end());
+
+    fan.clear();
+    fan.setPrimitiveType(sf::TriangleFan);
+    fan.append(sf::Vertex(origin, color));
+
+    for(const auto& [angle, i] : order)
+    {
+        const Ray& ray = rays[i];
+        fan.append(sf::Vertex(ray.p1 + (ray.p2 - ray.p1) * hits[i], color));
+    }
+
+    // Closing the fan
+    if(fan.getVertexCount() > 1)
+        fan.append(fan[1]);
+}
+// ------------------------------------------------------------------------
+
+// Bringing the lights' hits up to date on the pool, casting only what changed since the last call.
+// A light that moved (or is new) casts all of its rays against the BVH. The others keep their rays and hits,
+// which only the edges added since, [firstEdge, end), can shorten, and cast rays to the new vertices only.
+// Then every light that changed looks for the corners between its rays, and casts the rays to them, until it finds none.
+// Every ray writes its own hit slot, the buffers are rebuilt before the cast.
+static void castLights(const std::vector<sf::Vector2f>& lights, const std::vector<bool>& moved, const size_t firstEdge,
+                       const EdgeBuffer& edges, const EdgeBVH& bvh, CastPool& pool, LightRays& cast)
+{
+    const size_t added = edges.size() - firstEdge;
+
+    LightRays next;
+
+    // The rays from firstFresh[k] on have no hit yet
+    std::vector<size_t> firstFresh;
+
+    for(size_t k = 0; k < lights.size(); k++)
+    {
+        next.firstRay.push_back(next.rays.size());
+
+        if(!moved[k])
+        {
+            next.rays.insert(next.rays.end(), cast.rays.begin() + cast.firstRay[k], cast.rays.begin() + cast.firstRay[k + 1]);
+            next.hits.insert(next.hits.end(), cast.hits.begin() + cast.firstRay[k], cast.hits.begin() + cast.firstRay[k + 1]);
+            next.edges.insert(next.edges.end(), cast.edges.begin() + cast.firstRay[k], cast.edges.begin() + cast.firstRay[k + 1]);
+        }
+
+        firstFresh.push_back(next.rays.size());
+        lightRays(lights[k], edges, next.rays, moved[k] ? 0 : firstEdge);
+        next.hits.resize(next.rays.size());
+        next.edges.resize(next.rays.size());
+    }
+
+    // The rays of the first round may also be kept ones the added edges shorten, later rounds only cast fresh ones
+    for(unsigned int round = 0; ; round++)
+    {
+        next.firstRay.push_back(next.rays.size());
+
+        const size_t update = round == 0 ? added : 0;
+
+        pool.run(next.rays.size(), [&](const size_t first, const size_t count) {
+            // The light of the chunk's first ray
+            size_t k = std::upper_bound(next.firstRay.begin(), next.firstRay.end(), first) - next.firstRay.begin() - 1;
+
+            for(size_t i = first; i < first + count; i++)
+            {
+                while(i >= next.firstRay[k + 1])
+                    k++;
+
+                const Ray& ray = next.rays[i];
+
+                if(i >= firstFresh[k])
+                    next.hits[i] = bvh.closestHit(ray, nullptr, &next.edges[i]);
+                else if(update > 0)
+                {
+                    const sf::Vector2f d = ray.p2 - ray.p1;
+                    const float t = closestHitEdges(ray.p1, d, edges, firstEdge, update, next.hits[i], bvh.isa);
+
+                    if(t < next.hits[i])
+                    {
+                        next.hits[i]  = t;
+                        next.edges[i] = edgeHitAt(ray.p1, d, edges, firstEdge, update, t);
+                    }
+                }
+            }
+        });
+
+        if(round == CornerRounds)
+            break;
+
+        // Every light's rays so far, then the rays to its new corners
+        LightRays grown;
+        firstFresh.clear();
+
+        for(size_t k = 0; k < lights.size(); k++)
+        {
+            const size_t first = next.firstRay[k], last = next.firstRay[k + 1];
+
+            grown.firstRay.push_back(grown.rays.size());
+            grown.rays.insert(grown.rays.end(), next.rays.begin() + first, next.rays.begin() + last);
+            grown.hits.insert(grown.hits.end(), next.hits.begin() + first, next.hits.begin() + last);
+            grown.edges.insert(grown.edges.end(), next.edges.begin() + first, next.edges.begin() + last);
+
+            firstFresh.push_back(grown.rays.size());
+
+            if(moved[k] || added > 0)
+                lightCorners(lights[k], edges, next, first, last, grown.rays);
+
+            grown.hits.resize(grown.rays.size());
+            grown.edges.resize(grown.rays.size());
+        }
+
+        if(grown.rays.size() == next.rays.size())
+            break;
+
+        next = std::move(grown);
+    }
+
+    cast = std::move(next);
+}
+// ------------------------------------------------------------------------
+
+// Creates a shape with the given points and size at the mouse position
+static sf::CircleShape createShape(const sf::Vector2i mousepos, const float radius, const unsigned int points)
+{
+    sf::CircleShape shape;
+
+    shape.setFillColor(sf::Color::Transparent);
+    shape.setOutlineColor(sf::Color::Black);
+    shape.setOutlineThickness(1);
+    shape.setPointCount(points);
+    shape.setRadius(radius);
+    shape.setOrigin(sf::Vector2f(shape.getRadius(), shape.getRadius()));
+    shape.setPosition(vector_cast<float>(mousepos));
+
+    return shape;
+}
+
+// Creates a shape with random points and size at the mouse position, from the given generator
+static sf::CircleShape createShape(const sf::Vector2i mousepos, std::mt19937& gen)
+{
+    const unsigned int points = random(gen, 3, 10);
+    const float radius = random(gen, 30, 120);
+
+    return createShape(mousepos, radius, points);
+}
+
+// Creates a shape with random points and size at the mouse position
+static sf::CircleShape createShape(const sf::Vector2i mousepos)
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+
+    return createShape(mousepos, gen);
+}
+// ------------------------------------------------------------------------
+
+// How a shape moves while M is on, in pixels and degrees per second.
+struct Motion { sf::Vector2f velocity; float spin; };
+
+static Motion randomMotion()
+{
+    return Motion { sf::Vector2f(random(-60.f, 60.f), random(-60.f, 60.f)), random(-90.f, 90.f) };
+}
+// ------------------------------------------------------------------------
+
+// Moving and turning a shape for dt seconds, its center bounces off the window's border
+static void moveShape(sf::CircleShape& shape, Motion& motion, const float dt)
+{
+    shape.move(motion.velocity * dt);
+    shape.rotate(motion.spin * dt);
+
+    const auto position = shape.getPosition();
+
+    if((position.x < 0 && motion.velocity.x < 0) || (position.x > Width && motion.velocity.x > 0))
+        motion.velocity.x = -motion.velocity.x;
+
+    if((position.y < 0 && motion.velocity.y < 0) || (position.y > Height && motion.velocity.y > 0))
+        motion.velocity.y = -motion.velocity.y;
+}
+// ------------------------------------------------------------------------
+
+// The benchmark's scenes, the same seed builds the same shapes and lights every run.
+constexpr unsigned int BenchSeed = 2020;
+constexpr unsigned int BenchScenes[] = { 10, 100, 1000, 10000 };
+constexpr unsigned int BenchLights = 4;
+constexpr unsigned int BenchRepeats = 3;
+
+// Brute force tests every ray against every edge, it's only timed on this many of the rays
+constexpr size_t BenchBruteRays = 2048;
+
+// A scene of count shapes made like the ones the mouse places, all over the window, and the lights looking at it
+struct BenchScene
+{
+    EdgeBuffer edges;
+    std::vector<sf::Vector2f> lights;
+};
+
+static BenchScene benchScene(const unsigned int count, const unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    BenchScene scene;
+
+    scene.edges.addBorder(Width, Height);
+
+    for(unsigned int i = 0; i < count; i++)
+        scene.edges.addShape(createShape(sf::Vector2i(random(gen, 0, static_cast<int>(Width)), random(gen, 0, static_cast<int>(Height))), gen));
+
+    for(unsigned int i = 0; i < BenchLights; i++)
+        scene.lights.emplace_back(random(gen, 0.f, Width), random(gen, 0.f, Height));
+
+    return scene;
+}
+
+// The area of a simple polygon
+static double polygonArea(const std::vector<sf::Vector2f>& polygon)
+{
+    double area = 0;
+
+    for(size_t i = 0; i < polygon.size(); i++)
+    {
+        const sf::Vector2f p = polygon[i], q = polygon[(i + 1) % polygon.size()];
+        area += cross(p.x, p.y, q.x, q.y);
+    }
+
+    return std::fabs(area) / 2;
+}
+
+// The largest difference between the area of the sweep's polygon and the cast's, as a fraction of the cast's,
+// over the lights. The cast has a ray to every corner, so it's the reference.
+static double sweepDifference(const EdgeBuffer& edges, const EdgeBVH& bvh, const std::vector<Crossing>& crossings, const std::vector<sf::Vector2f>& lights)
+{
+    const std::vector<Edge> pieces = splitCrossingEdges(edges, crossings);
+    double difference = 0;
+
+    CastPool pool(1);
+    LightRays cast;
+    castLights(lights, std::vector<bool>(lights.size(), true), 0, edges, bvh, pool, cast);
+
+    for(size_t k = 0; k < lights.size(); k++)
+    {
+        const sf::Vector2f light = lights[k];
+
+        sf::VertexArray fan;
+        lightPolygon(light, cast.rays, cast.hits, cast.firstRay[k], cast.firstRay[k + 1], sf::Color::White, fan);
+
+        // Without the origin and the closing vertex
+        std::vector<sf::Vector2f> cast;
+        for(size_t i = 1; i + 1 < fan.getVertexCount(); i++)
+            cast.push_back(fan[i].position);
+
+        const double castArea = polygonArea(cast);
+        difference = std::max(difference, std::fabs(polygonArea(visibilityPolygon(light, pieces)) - castArea) / castArea);
+    }
+
+    return difference;
+}
+
+// The sweep is checked against the cast on the benchmark's scenes up to this many shapes, the larger ones have millions of crossings
+constexpr unsigned int SweepCheckShapes = 1000;
+
+// The sweep's polygons may differ from the cast's by this fraction of their area, the cast's side rays cut corners a little
+constexpr double SweepTolerance = 5e-3;
+
+// A shape like the ones the mouse places, by its center, radius and point count
+struct VerifyShape { int x, y; float radius; unsigned int points; };
+
+// The sweep once lost the nearest segment from SweepRegressionLight among these shapes, its polygon came out 68% off.
+// They're written out rather than drawn from a seed, the standard library's distributions aren't the same everywhere.
+constexpr VerifyShape SweepRegressionShapes[] = {
+    {  22, 544,  68, 9 },
+    { 166, 480, 117, 9 },
+    {  19, 508,  56, 8 },
+    {  22, 413, 113, 6 },
+};
+
+const sf::Vector2f SweepRegressionLight(65, 524);
+
+// Checking the sweep against the cast without a window, on the regression scene and the benchmark's scenes
+// up to SweepCheckShapes shapes with their lights, any polygon off by SweepTolerance or more fails.
+static int verifySweep()
+{
+    EdgeBuffer edges;
+    edges.addBorder(Width, Height);
+
+    for(const auto& shape : SweepRegressionShapes)
+        edges.addShape(createShape(sf::Vector2i(shape.x, shape.y), shape.radius, shape.points));
+
+    EdgeBVH bvh;
+    bvh.build(edges);
+
+    double worst = sweepDifference(edges, bvh, crossingEdges(bvh), { SweepRegressionLight });
+    std::cout << std::left << std::setw(12) << "regression" << worst << std::endl;
+
+    for(const unsigned int count : BenchScenes)
+    {
+        if(count > SweepCheckShapes)
+            continue;
+
+        const BenchScene scene = benchScene(count, BenchSeed + count);
+
+        EdgeBVH sceneBvh;
+        sceneBvh.build(scene.edges);
+
+        const double difference = sweepDifference(scene.edges, sceneBvh, crossingEdges(sceneBvh), scene.lights);
+        std::cout << std::left << std::setw(12) << count << difference << std::endl;
+
+        worst = std::max(worst, difference);
+    }
+
+    std::cout << "Sweep against cast, largest area difference: " << worst << std::endl;
+    return worst < SweepTolerance ? 0 : 1;
+}
+// ------------------------------------------------------------------------
+
+// Timing the cast stage alone on the benchmark scenes, for brute force and the BVH, every instruction set the CPU has
+// and 1, 2, 4... up to max_threads threads, and writing the results as JSON to path.
+// The rays of all the lights are made before the clock starts, only casting them is timed, the best of BenchRepeats runs.
+// Edge tests are the ray-edge pairs that were tested, for the BVH the edges in the leaves every ray visited.
+static int runBenchmark(const std::string& path, const unsigned int maxThreads)
+{
+    std::vector<Isa> isas { Isa::Scalar };
+    if(detectIsa() != Isa::Scalar)
+        isas.push_back(Isa::AVX2);
+    if(detectIsa() == Isa::AVX512)
+        isas.push_back(Isa::AVX512);
+
+    const char* isaNames[] = { "scalar", "avx2", "avx512" };
+
+    std::vector<unsigned int> threadCounts;
+    for(unsigned int threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(std::max(maxThreads, 1u));
+
+    std::ostringstream results;
+    bool firstResult = true;
+    bool agree = true;
+
+    std::cout << std::left << std::setw(10) << "polygons" << std::setw(13) << "algorithm" << std::setw(8) << "isa" << std::setw(9) << "threads"
+              << std::setw(10) << "rays" << std::setw(14) << "Mrays/s" << "Medge tests/s" << std::endl;
+
+    for(const unsigned int count : BenchScenes)
+    {
+        const BenchScene scene = benchScene(count, BenchSeed + count);
+
+        EdgeBVH bvh;
+        bvh.build(scene.edges);
+
+        // Every light's rays with the ones to its corners, which take casting the rest first
+        CastPool castPool(1);
+        LightRays lit;
+        castLights(scene.lights, std::vector<bool>(scene.lights.size(), true), 0, scene.edges, bvh, castPool, lit);
+
+        const std::vector<Ray>& rays = lit.rays;
+
+        // An even sample of the rays for brute force
+        std::vector<Ray> sample;
+        const size_t stride = std::max<size_t>(rays.size() / BenchBruteRays, 1);
+        for(size_t i = 0; i < rays.size(); i += stride)
+            sample.push_back(rays[i]);
+
+        // The BVH's edge tests don't depend on the kernel, they're counted once
+        size_t bvhTests = 0;
+        for(const auto& ray : rays)
+            bvh.closestHit(ray, &bvhTests);
+
+        // Both algorithms have to find the same hits, up to rounding where two hits are within an ulp of each other
+        std::vector<float> reference(rays.size());
+        for(size_t i = 0; i < rays.size(); i++)
+            reference[i] = bvh.closestHit(rays[i]);
+
+        for(const unsigned int threads : threadCounts)
+        {
+            CastPool pool(threads);
+
+            for(const Isa isa : isas)
+            {
+                bvh.isa = isa;
+
+                for(const bool bruteForce : { true, false })
+                {
+                    const std::vector<Ray>& cast = bruteForce ? sample : rays;
+                    std::vector<float> hits(cast.size());
+
+                    double seconds = std::numeric_limits<double>::max();
+
+                    for(unsigned int repeat = 0; repeat < BenchRepeats; repeat++)
+                    {
+                        const auto start = std::chrono::steady_clock::now();
+
+                        pool.run(cast.size(), [&](const size_t first, const size_t chunk) {
+                            for(size_t i = first; i < first + chunk; i++)
+                            {
+                                const Ray& ray = cast[i];
+
+                                hits[i] = bruteForce ? closestHitEdges(ray.p1, ray.p2 - ray.p1, scene.edges, 0, scene.edges.size(), 1, isa)
+                                                     : bvh.closestHit(ray);
+                            }
+                        });
+
+                        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                        seconds = std::min(seconds, elapsed.count());
+                    }
+
+                    float difference = 0;
+                    for(size_t i = 0; i < cast.size(); i++)
+                        difference = std::max(difference, std::fabs(hits[i] - reference[bruteForce ? i * stride : i]));
+
+                    agree = agree && difference < 1e-4f;
+
+                    const size_t tests       = bruteForce ? cast.size() * scene.edges.size() : bvhTests;
+                    const double raysPerSec  = cast.size() / seconds;
+                    const double testsPerSec = tests / seconds;
+                    const char* algorithm    = bruteForce ? "brute-force" : "bvh";
+
+                    std::cout << std::left << std::setw(10) << count << std::setw(13) << algorithm << std::setw(8) << isaNames[static_cast<int>(isa)]
+                              << std::setw(9) << threads << std::setw(10) << cast.size() << std::setw(14) << raysPerSec / 1e6 << testsPerSec / 1e6 << std::endl;
+
+                    results << (firstResult ? "" : ",") << "\n    { \"polygons\": " << count << ", \"edges\": " << scene.edges.size()
+                            << ", \"algorithm\": \"" << algorithm << "\", \"isa\": \"" << isaNames[static_cast<int>(isa)] << "\", \"threads\": " << threads
+                            << ", \"rays\": " << cast.size() << ", \"edge_tests\": " << tests << ", \"seconds\": " << seconds
+                            << ", \"rays_per_second\": " << raysPerSec << ", \"edge_tests_per_second\": " << testsPerSec
+                            << ", \"max_difference\": " << difference << " }";
+                    firstResult = false;
+                }
+            }
+        }
+    }
+
+    std::ofstream file(path);
+    file << "{\n  \"seed\": " << BenchSeed << ",\n  \"width\": " << Width << ",\n  \"height\": " << Height
+         << ",\n  \"lights\": " << BenchLights << ",\n  \"leaf_edges\": " << EdgeBVH::LeafEdges
+         << ",\n  \"results\": [" << results.str() << "\n  ]\n}\n";
+
+    if(!file)
+    {
+        std::cerr << "Can't write " << path << std::endl;
+        return 1;
+    }
+
+    std::cout << "Results written to " << path << std::endl;
+    return agree ? 0 : 1;
+}
+// ------------------------------------------------------------------------
+
+// Parsing a whole argument as a count, an argument with anything else in it, or out of range, throws std::invalid_argument
+static unsigned int parseCount(const std::string& text)
+{
+    if(text.empty() || text[0] < '0' || text[0] > '9')
+        throw std::invalid_argument("not a count: " + text);
+
+    size_t used = 0;
+    unsigned long value = 0;
+
+    try { value = std::stoul(text, &used); }
+    catch(const std::out_of_range&) { used = 0; }
+
+    if(used != text.size() || value > std::numeric_limits<unsigned int>::max())
+        throw std::invalid_argument("not a count: " + text);
+
+    return static_cast<unsigned int>(value);
+}
+// ------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    // Amount of cast threads, can be changed with: --threads N
+    unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // Timing the cast on generated scenes without a window, results as JSON: --bench <file.json>
+    std::string benchPath;
+
+    // Checking the sweep's polygons against the cast's without a window: --verify
+    bool verify = false;
+
+    auto usage = [&]() {
+        std::cerr << "Usage: " << argv[0] << " [--threads N] [--bench <file.json>] [--verify]" << std::endl;
+        return 1;
+    };
+
+    try
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+
+            if(arg == "--threads" && i + 1 < argc)
+            {
+                threads = parseCount(argv[++i]);
+
+                if(threads == 0)
+                    return usage();
+            }
+
+            else if(arg == "--bench" && i + 1 < argc)
+                benchPath = argv[++i];
+
+            else if(arg == "--verify")
+                verify = true;
+
+            else
+                return usage();
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cerr << "Bad argument: " << error.what() << std::endl;
+        return usage();
+    }
+
+    if(verify)
+        return verifySweep();
+
+    if(!benchPath.empty())
+        return runBenchmark(benchPath, threads);
+
+    // Creates a window with AA
+    sf::ContextSettings settings;
+    settings.antialiasingLevel = 32;
+    sf::RenderWindow window(sf::VideoMode(Width, Height), "Raycast 2D Test", sf::Style::Default, settings);
+
+    // The shapes that will appear on the screen, and how they move
+    std::vector<sf::CircleShape> shapes;
+    std::vector<Motion> motions;
+
+    // M sets the shapes in motion and stops them again
+    bool moving = false;
+    sf::Clock clock;
+
+    // Their edges in world space and the BVH over them, both only change when a shape is added or moves.
+    // Moving shapes only refit the BVH, it's built again when a shape is added or the refit got too loose.
+    // The window's border is part of the scene, it closes the light polygons.
+    EdgeBuffer sceneEdges;
+    sceneEdges.addBorder(Width, Height);
+
+    EdgeBVH bvh;
+    bvh.build(sceneEdges);
+
+    // The edges cut where they cross for the sweep, only cut again when the sweep needs them after the scene changed.
+    // The cast finds the crossings it needs itself, so moving shapes only pay for them in the sweep.
+    std::vector<Edge> sweepEdges;
+    bool splitStale = true;
+
+    // The lights, the first one follows the mouse and the right button places more
+    std::vector<sf::Vector2f> lights(1);
+
+    // The rays of all the lights are cast together on every core, into one hit slot per ray
+    CastPool pool(threads);
+    LightRays cast;
+
+    // Every light's polygon is added into the light map, which is drawn over the scene in one go.
+    // The map holds colors already multiplied by their alpha, the light map is drawn with the matching blend mode.
+    std::vector<sf::VertexArray> fans;
+    const sf::Color lightColor(255, 0, 0, 90);
+
+    sf::RenderTexture lightMap;
+    lightMap.create(Width, Height);
+    const sf::BlendMode premultiplied(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha);
+
+    // V switches between casting rays to every vertex and the angular sweep
+    bool sweep = false;
+
+    // What the light polygons were built for, only the lights that moved or a grown scene build them again
+    std::vector<sf::Vector2f> litFrom;
+    size_t litEdges = 0;
+    bool litSweep = false;
+
+    // Nothing changed last frame, the picture on screen is up to date
+    bool idle = false;
+
+    while(window.isOpen())
+    {
+        // When idle the loop sleeps until the next event, instead of drawing the same frame again
+        sf::Event event;
+        bool waited = idle && window.waitEvent(event);
+
+        const auto MousePos = sf::Mouse::getPosition(window);
+
+        // Events handling
+        while(waited || window.pollEvent(event)) 
+        {
+            waited = false;
+
+            // When exit button pressed then actually exit.
+            if(event.type == sf::Event::Closed)
+                window.close();
+
+            // When mouse pressed create a shape, or a light with the right button
+            if(event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right)
+                lights.push_back(vector_cast<float>(MousePos));
+            else if(event.type == sf::Event::MouseButtonPressed)
+            {
+                shapes.push_back(createShape(MousePos));
+                motions.push_back(randomMotion());
+                sceneEdges.addShape(shapes.back());
+                bvh.build(sceneEdges);
+                splitStale = true;
+            }
+
+            if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::M)
+            {
+                moving = !moving;
+                clock.restart();
+            }
+
+            if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::V)
+            {
+                sweep = !sweep;
+                window.setTitle(sweep ? "Raycast 2D Test (sweep)" : "Raycast 2D Test");
+            }
+        }
+
+        lights[0] = vector_cast<float>(MousePos);
+
+        // Moving the shapes, their edges are updated in place
+        const float dt = clock.restart().asSeconds();
+        const bool sceneMoved = moving && !shapes.empty();
+
+        if(sceneMoved)
+        {
+            for(size_t i = 0; i < shapes.size(); i++)
+            {
+                moveShape(shapes[i], motions[i], dt);
+                sceneEdges.updateShape(i, shapes[i]);
+            }
+
+            if(!bvh.refit(sceneEdges))
+                bvh.build(sceneEdges);
+
+            splitStale = true;
+        }
+
+        // Switching modes or moving shapes builds every polygon again
+        std::vector<bool> moved(lights.size(), true);
+        bool anyMoved = false;
+
+        for(size_t k = 0; k < lights.size(); k++)
+        {
+            moved[k] = sceneMoved || sweep != litSweep || k >= litFrom.size() || lights[k] != litFrom[k];
+            anyMoved = anyMoved || moved[k];
+        }
+
+        const bool added = sceneEdges.size() != litEdges;
+        idle = !anyMoved && !added;
+
+        if(!idle)
+        {
+            fans.resize(lights.size(), sf::VertexArray(sf::TriangleFan));
+
+            if(sweep)
+            {
+                if(splitStale)
+                {
+                    sweepEdges = splitCrossingEdges(sceneEdges, crossingEdges(bvh));
+                    splitStale = false;
+                }
+
+                // The sweep builds the visibility polygons directly
+                for(size_t k = 0; k < lights.size(); k++)
+                {
+                    if(!moved[k] && !added)
+                        continue;
+
+                    sf::VertexArray& fan = fans[k];
+
+                    fan.clear();
+                    fan.append(sf::Vertex(lights[k], lightColor));
+
+                    for(const auto& point : visibilityPolygon(lights[k], sweepEdges))
+                        fan.append(sf::Vertex(point, lightColor));
+
+                    // Closing the fan
+                    if(fan.getVertexCount() > 1)
+                        fan.append(fan[1]);
+                }
+            }
+            else
+            {
+                // Every ray only checks the edges in the BVH leaves it crosses, and ends at its closest hit
+                castLights(lights, moved, litEdges, sceneEdges, bvh, pool, cast);
+
+                for(size_t k = 0; k < lights.size(); k++)
+                    if(moved[k] || added)
+                        lightPolygon(lights[k], cast.rays, cast.hits, cast.firstRay[k], cast.firstRay[k + 1], lightColor, fans[k]);
+            }
+
+            // Adding up the lights
+            lightMap.clear(sf::Color::Transparent);
+
+            for(const auto& fan : fans)
+                lightMap.draw(fan, sf::BlendAdd);
+
+            lightMap.display();
+
+            litFrom  = lights;
+            litEdges = sceneEdges.size();
+            litSweep = sweep;
+        }
+
+        // Clears GPU Buffer
+        window.clear(sf::Color::White);
+
+        // Shape Draws
+        for(auto& shape : shapes)
+            window.draw(shape);
+
+        window.draw(sf::Sprite(lightMap.getTexture()), premultiplied);
+
         // Swap GPU Buffers
         window.display();
     }
@@ -12,13 +12,60 @@
 
 #include <iostream> 
 #include <complex>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <future>
+#include <filesystem>
+#include <cstring>
+#include <list>
+#include <map>
+#include <tuple>
+#include <random>
+
+// The vectorized kernels use GCC/Clang target attributes, so they are only built for x86 on those compilers.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define MANDELBROT_X86_SIMD
+    #include <immintrin.h>
+#endif
+
+// The formula steps are forced into the kernels that run them, whatever their size.
+#if defined(__GNUC__) || defined(__clang__)
+    #define MANDELBROT_INLINE __attribute__((always_inline)) inline
+#elif defined(_MSC_VER)
+    #define MANDELBROT_INLINE __forceinline
+#else
+    #define MANDELBROT_INLINE inline
+#endif
 // --------------------------------------------------------------
 
 constexpr unsigned int Width  = 800;
 constexpr unsigned int Height = 800;
 
-// Max Iterations to allow for the mandelbrot set
+// Max Iterations to allow for the mandelbrot set, unless it's set or picked per view
 constexpr unsigned int MaxIterations = 1000;
+
+// Hard cap for automatically picked limits, the counts are stored in 16 bits.
+constexpr unsigned int IterationCap = 65535;
+
+// Side length of the square tiles the image is split into for rendering.
+constexpr unsigned int TileSize = 32;
 // --------------------------------------------------------------
 
 // Mapping a numeric range onto another numeric range.
@@ -70,66 +117,3406 @@ static sf::Color pick_color(unsigned int iter)
 }
 // --------------------------------------------------------------
 
-static sf::Image mandelbrot_set(double min, double max)
+// A rectangular block of pixels that is rendered as one unit of work.
+struct Tile { unsigned int x, y, width, height; };
+// --------------------------------------------------------------
+
+// A thread pool where every worker owns a deque of tiles.
+// A worker pops tiles from the back of its own deque, and once it's empty
+// it steals from the front of the other workers' deques, so the workers
+// that got the cheap (exterior) tiles end up helping with the expensive (interior) ones.
+class WorkStealingPool
 {
-    sf::Image image;
-    image.create(Width, Height, sf::Color::White);
+public:
+    using Job = std::function<void(const Tile&, unsigned int worker)>;
 
-    // Start of the mandelbrot set
-    for(size_t y = 0; y < Height; y++)
+    explicit WorkStealingPool(unsigned int threads)
+    {
+        if(threads == 0)
+            threads = 1;
+
+        for(unsigned int i = 0; i < threads; i++)
+            queues.push_back(std::make_unique<Queue>());
+
+        for(unsigned int i = 0; i < threads; i++)
+            workers.emplace_back(&WorkStealingPool::worker, this, i);
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for(auto& thread : workers)
+            thread.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // Runs the job on every tile and blocks until all of them are done.
+    void run(const std::vector<Tile>& tiles, const Job& job)
+    {
+        if(tiles.empty())
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Workers that are still draining the previous run hold a pointer to its job.
+        done.wait(lock, [this] { return active == 0; });
+
+        current = &job;
+        remaining = tiles.size();
+
+        // Deal the tiles round robin, so every worker starts with a mix of the image.
+        for(size_t i = 0; i < tiles.size(); i++)
+            queues[i % queues.size()]->tiles.push_back(tiles[i]);
+
+        generation++;
+        wake.notify_all();
+
+        done.wait(lock, [this] { return remaining == 0 && active == 0; });
+        current = nullptr;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+
+    // Taking a tile from the back of the worker's own deque.
+    bool pop(unsigned int index, Tile& tile)
+    {
+        Queue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if(queue.tiles.empty())
+            return false;
+
+        tile = queue.tiles.back();
+        queue.tiles.pop_back();
+        return true;
+    }
+
+    // Taking a tile from the front of another worker's deque.
+    bool steal(unsigned int index, Tile& tile)
     {
-        for(size_t x = 0; x < Width; x++)
+        for(size_t i = 1; i < queues.size(); i++)
         {
-            // Mandelbrot Zoom
-            const double x_scaled = numeric_map(static_cast<double>(x), 0.0, static_cast<double>(Width), min, max);
-            const double y_scaled = numeric_map(static_cast<double>(y), 0.0, static_cast<double>(Height), min, max);
+            Queue& victim = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if(victim.tiles.empty())
+                continue;
+
+            tile = victim.tiles.front();
+            victim.tiles.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    void worker(unsigned int index)
+    {
+        unsigned long long seen = 0;
 
-            // The formula complex variables
-            //           2
-            // Z     =  Z  + c
-            //  n+1      n
-            std::complex<double> c(x_scaled, y_scaled);
-            std::complex<double> z(0.0, 0.0);
-            int n = 0;
+        while(true)
+        {
+            const Job* job;
 
-            while(std::abs(z) < 2.0 && n < MaxIterations)
             {
-                z = (z * z) + c;
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+
+                if(stopping)
+                    return;
+
+                seen = generation;
+                job  = current;
+                active++;
+            }
 
-                n++;
+            Tile tile;
+            while(job && (pop(index, tile) || steal(index, tile)))
+            {
+                (*job)(tile, index);
+                remaining--;
             }
 
-            // Make sure the iterations are inbounds
-            if(n < MaxIterations && n > 0)
-                n %= 16;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active--;
+            }
 
-            image.setPixel(x, y, pick_color(n));
+            done.notify_all();
         }
     }
 
-    return image;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const Job* current = nullptr;
+    unsigned long long generation = 0;
+    unsigned int active = 0;
+    std::atomic<size_t> remaining { 0 };
+    bool stopping = false;
+};
+// --------------------------------------------------------------
+
+// Splitting a width x height image into tiles of TileSize (the edge tiles may be smaller).
+static std::vector<Tile> make_tiles(unsigned int width, unsigned int height)
+{
+    std::vector<Tile> tiles;
+
+    for(unsigned int y = 0; y < height; y += TileSize)
+        for(unsigned int x = 0; x < width; x += TileSize)
+            tiles.push_back({ x, y, std::min(TileSize, width - x), std::min(TileSize, height - y) });
+
+    return tiles;
 }
 // --------------------------------------------------------------
 
-int main()
+// Instruction set used by the escape-time kernel.
+enum class Isa { Scalar, AVX2, AVX512 };
+
+static const char* isa_name(Isa isa)
 {
-    sf::RenderWindow window(sf::VideoMode(Width, Height), "Mandelbrot Set");
+    switch(isa)
+    {
+        case Isa::AVX2:   return "avx2";
+        case Isa::AVX512: return "avx512";
+        default:          return "scalar";
+    }
+}
 
-    // Making sf::Image drawable
-    sf::Texture tex;
-    tex.loadFromImage(mandelbrot_set(-2, 2));
-    sf::Sprite output(tex);
+// The widest instruction set the running CPU supports.
+static Isa detect_isa()
+{
+#ifdef MANDELBROT_X86_SIMD
+    __builtin_cpu_init();
 
-    while(window.isOpen())
+    if(__builtin_cpu_supports("avx512f"))
+        return Isa::AVX512;
+
+    if(__builtin_cpu_supports("avx2"))
+        return Isa::AVX2;
+#endif
+
+    return Isa::Scalar;
+}
+// --------------------------------------------------------------
+
+// Scalar type the escape-time kernel runs in, picked from the pixel spacing.
+// float is enough for shallow views and has twice the SIMD lanes, long double
+// goes further than double but only runs on the scalar path.
+enum class Precision { Auto, Float, Double, LongDouble };
+
+static const char* precision_name(Precision precision)
+{
+    switch(precision)
     {
-        // Window Events Handling
-        sf::Event event;
-        while(window.pollEvent(event))
+        case Precision::Float:      return "float";
+        case Precision::Double:     return "double";
+        case Precision::LongDouble: return "long double";
+        default:                    return "auto";
+    }
+}
+// --------------------------------------------------------------
+
+// Fractal the escape-time kernel iterates, every one has its own formula policy below.
+enum class Fractal { Mandelbrot, Julia, Multibrot, BurningShip };
+
+// Multibrot powers with a compiled kernel, z^3 + c up to z^MaxPower + c.
+constexpr unsigned int MaxPower = 6;
+
+static const char* fractal_name(Fractal fractal)
+{
+    switch(fractal)
+    {
+        case Fractal::Julia:       return "julia";
+        case Fractal::Multibrot:   return "multibrot";
+        case Fractal::BurningShip: return "burning-ship";
+        default:                   return "mandelbrot";
+    }
+}
+// --------------------------------------------------------------
+
+// Switches for the kernel, the interior shortcuts never change the result, only the speed.
+struct RenderSettings
+{
+    Isa isa = Isa::Scalar;
+
+    // Formula of the kernel, with the power of the Multibrot set (z^power + c)
+    // and the constant c of the Julia set, whose pixels are the starting z.
+    Fractal fractal = Fractal::Mandelbrot;
+    unsigned int power = 3;
+    long double julia_re = -0.8L, julia_im = 0.156L;
+
+    // Scalar type of the kernel, Auto picks the cheapest one that's still accurate.
+    Precision precision = Precision::Auto;
+
+    // Analytic test for the main cardioid and the period-2 bulb.
+    bool cardioid_check = true;
+
+    // Brent-style cycle detection on the orbit.
+    bool periodicity_check = true;
+
+    // Mariani-Silver subdivision, only the borders of uniform rectangles are computed.
+    bool subdivision = false;
+
+    // Iteration limit of the kernel.
+    unsigned int max_iterations = MaxIterations;
+
+    // Picking the limit for every frame and tile from a low resolution probe, never above iteration_cap.
+    bool auto_iterations = false;
+    unsigned int iteration_cap = IterationCap;
+
+    // The count of the points inside the set, the highest count a render can hold.
+    unsigned int inside_count() const { return auto_iterations ? iteration_cap : max_iterations; }
+};
+// --------------------------------------------------------------
+
+// Checking if c is inside the main cardioid or the period-2 bulb, both are inside the set.
+// Cardioid: q * (q + (x - 1/4)) <= y^2 / 4, where q = (x - 1/4)^2 + y^2
+// Bulb:     (x + 1)^2 + y^2 <= 1/16
+template<typename T>
+static inline bool in_cardioid_or_bulb(T cr, T ci)
+{
+    const T ci2 = ci * ci;
+    const T xq  = cr - T(0.25);
+    const T q   = xq * xq + ci2;
+
+    if(q * (q + xq) <= T(0.25) * ci2)
+        return true;
+
+    const T xb = cr + T(1);
+    return xb * xb + ci2 <= T(0.0625);
+}
+// --------------------------------------------------------------
+
+// The scalar counterpart of the vector operations the formula policies need besides + - *.
+template<typename T>
+struct ScalarOps
+{
+    static MANDELBROT_INLINE void abs(T& a) { a = std::fabs(a); }
+};
+// --------------------------------------------------------------
+
+// The formulas the escape-time kernels iterate, picked at compile time.
+// A formula is a policy with one step() written with + - *, which work the same on scalars
+// and on GCC/Clang vector types, and an operations type (ScalarOps, Avx2Ops or Avx512Ops)
+// for the rest. Every kernel is a template over it, so each formula gets its
+// own fully inlined loop with no call per iteration. zr2 and zi2 are the squares of the
+// current z, the kernel has them from the escape test anyway.
+// PixelIsZ:  the pixel is the starting z and c is constant (Julia), otherwise z starts at 0 and c is the pixel.
+// Interior:  the cardioid and bulb test applies.
+// 2 * zr * zi is written as p + p, which is exactly the same number as p * 2.
+// The steps are compiled without a vector target, so they never pass or return a vector by value,
+// whose ABI would depend on the target.
+
+//           2
+// Z     =  Z  + c
+//  n+1      n
+// Written out as: re = zr^2 - zi^2 + cr, im = 2 * zr * zi + ci
+struct Mandelbrot
+{
+    static constexpr bool PixelIsZ = false;
+    static constexpr bool Interior = true;
+
+    template<typename Ops, typename Vec>
+    static MANDELBROT_INLINE void step(Vec& zr, Vec& zi, const Vec& zr2, const Vec& zi2, const Vec& cr, const Vec& ci)
+    {
+        const Vec product = zr * zi;
+
+        zi = (product + product) + ci;
+        zr = (zr2 - zi2) + cr;
+    }
+};
+
+// The Mandelbrot formula with a fixed c, the pixel is where the orbit starts.
+struct Julia : Mandelbrot
+{
+    static constexpr bool PixelIsZ = true;
+    static constexpr bool Interior = false;
+};
+
+//           Power
+// Z     =  Z      + c
+//  n+1      n
+// z^2 comes from the squares, every further power is one complex multiplication.
+// Power is a constant, so the loop is unrolled.
+template<unsigned int Power>
+struct Multibrot
+{
+    static_assert(Power >= 3, "Multibrot<2> is the Mandelbrot formula");
+
+    static constexpr bool PixelIsZ = false;
+    static constexpr bool Interior = false;
+
+    template<typename Ops, typename Vec>
+    static MANDELBROT_INLINE void step(Vec& zr, Vec& zi, const Vec& zr2, const Vec& zi2, const Vec& cr, const Vec& ci)
+    {
+        const Vec product = zr * zi;
+
+        Vec pr = zr2 - zi2;
+        Vec pi = product + product;
+
+        for(unsigned int k = 2; k < Power; k++)
         {
-            // Close window on exit button
-            if(event.type == sf::Event::Closed)
-                window.close(); 
+            const Vec re = pr * zr - pi * zi;
+            pi = pr * zi + pi * zr;
+            pr = re;
+        }
+
+        zr = pr + cr;
+        zi = pi + ci;
+    }
+};
+
+// The Mandelbrot formula on (|zr| + |zi| i), only the sign of 2 * zr * zi changes.
+// Written out as: re = zr^2 - zi^2 + cr, im = |2 * zr * zi| + ci
+struct BurningShip
+{
+    static constexpr bool PixelIsZ = false;
+    static constexpr bool Interior = false;
+
+    template<typename Ops, typename Vec>
+    static MANDELBROT_INLINE void step(Vec& zr, Vec& zi, const Vec& zr2, const Vec& zi2, const Vec& cr, const Vec& ci)
+    {
+        Vec product = zr * zi;
+        Ops::abs(product);
+
+        zi = (product + product) + ci;
+        zr = (zr2 - zi2) + cr;
+    }
+};
+// --------------------------------------------------------------
+
+// Counting the iterations until the point escapes, or the settings' max_iterations if it never does.
+// The point is c, or the starting z of a Julia set.
+// Squared magnitude is compared against 4 instead of |z| against 2, which saves
+// the sqrt (and hypot scaling) that std::abs does on every iteration.
+// When magnitude isn't null it receives |z|^2 at the escape, for smooth colouring.
+template<typename Formula, typename T>
+static unsigned int escape_time(T re, T im, const RenderSettings& settings, float* magnitude = nullptr)
+{
+    const unsigned int max_iterations = settings.max_iterations;
+
+    if constexpr(Formula::Interior)
+        if(settings.cardioid_check && in_cardioid_or_bulb(re, im))
+            return max_iterations;
+
+    T zr = 0, zi = 0, cr = re, ci = im;
+
+    if constexpr(Formula::PixelIsZ)
+    {
+        zr = re;
+        zi = im;
+        cr = static_cast<T>(settings.julia_re);
+        ci = static_cast<T>(settings.julia_im);
+    }
+
+    T zr2 = zr * zr, zi2 = zi * zi;
+    unsigned int n = 0;
+
+    // Brent's cycle detection: z is saved at iterations 0, 1, 2, 4, 8...
+    // and compared with every z after it. The comparison is exact, and an orbit that
+    // repeats itself exactly will repeat forever, so it would have reached max_iterations anyway.
+    T saved_r = zr, saved_i = zi;
+    unsigned int next_save = 1;
+
+    while(zr2 + zi2 < T(4) && n < max_iterations)
+    {
+        Formula::template step<ScalarOps<T>>(zr, zi, zr2, zi2, cr, ci);
+
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+
+        n++;
+
+        if(settings.periodicity_check)
+        {
+            if(zr == saved_r && zi == saved_i)
+                return max_iterations;
+
+            if(n == next_save)
+            {
+                saved_r = zr;
+                saved_i = zi;
+                next_save *= 2;
+            }
+        }
+    }
+
+    if(magnitude)
+        *magnitude = static_cast<float>(zr2 + zi2);
+
+    return n;
+}
+// --------------------------------------------------------------
+
+// Computing the escape time of count points, one after another.
+template<typename Formula, typename T>
+static void escape_time_scalar(const T* cr, const T* ci, unsigned int* iterations, float* magnitudes, size_t count, const RenderSettings& settings)
+{
+    for(size_t i = 0; i < count; i++)
+        iterations[i] = escape_time<Formula>(cr[i], ci[i], settings, magnitudes ? magnitudes + i : nullptr);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+// The formula policies are compiled without a target and GCC won't inline target
+// functions into them, so the arithmetic they use is written with vector operators
+// and has no target of its own. Inlined into a kernel it's compiled for the kernel's target.
+// abs clears the sign bit, the only bit -0.0 has set.
+#define VECTOR_ARITH __attribute__((always_inline)) static inline
+
+// The vector operations the AVX2 kernel needs, for float (8 lanes) and double (4 lanes).
+// Lane masks are full vectors of all ones, the counters are integers of the same width.
+template<typename T> struct Avx2Ops;
+
+template<> struct Avx2Ops<double>
+{
+    using Vec = __m256d;
+    using Int = long long;
+    static constexpr size_t Lanes = 4;
+
+    #define AVX2_OP __attribute__((target("avx2"), always_inline)) static inline
+    AVX2_OP Vec set1(double value)            { return _mm256_set1_pd(value); }
+    AVX2_OP Vec load(const double* values)    { return _mm256_loadu_pd(values); }
+    AVX2_OP void store(double* out, Vec a)    { _mm256_storeu_pd(out, a); }
+    VECTOR_ARITH void abs(Vec& a)               { a = reinterpret_cast<Vec>(reinterpret_cast<__m256i>(a) & ~reinterpret_cast<__m256i>(-Vec{})); }
+    AVX2_OP Vec less(Vec a, Vec b)            { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    AVX2_OP Vec equal(Vec a, Vec b)           { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    AVX2_OP Vec blend(Vec a, Vec b, Vec mask) { return _mm256_blendv_pd(a, b, mask); }
+    AVX2_OP bool any(Vec mask)                { return _mm256_movemask_pd(mask) != 0; }
+    AVX2_OP __m256i count(__m256i n, Vec alive) { return _mm256_sub_epi64(n, _mm256_castpd_si256(alive)); }
+    AVX2_OP __m256i set1_count(unsigned int n)  { return _mm256_set1_epi64x(n); }
+    AVX2_OP void store_counts(__m256i n, unsigned int* out)
+    {
+        alignas(32) long long counts[Lanes];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(counts), n);
+
+        for(size_t lane = 0; lane < Lanes; lane++)
+            out[lane] = static_cast<unsigned int>(counts[lane]);
+    }
+    #undef AVX2_OP
+};
+
+template<> struct Avx2Ops<float>
+{
+    using Vec = __m256;
+    using Int = int;
+    static constexpr size_t Lanes = 8;
+
+    #define AVX2_OP __attribute__((target("avx2"), always_inline)) static inline
+    AVX2_OP Vec set1(float value)             { return _mm256_set1_ps(value); }
+    AVX2_OP Vec load(const float* values)     { return _mm256_loadu_ps(values); }
+    AVX2_OP void store(float* out, Vec a)     { _mm256_storeu_ps(out, a); }
+    VECTOR_ARITH void abs(Vec& a)               { a = reinterpret_cast<Vec>(reinterpret_cast<__m256i>(a) & ~reinterpret_cast<__m256i>(-Vec{})); }
+    AVX2_OP Vec less(Vec a, Vec b)            { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    AVX2_OP Vec equal(Vec a, Vec b)           { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    AVX2_OP Vec blend(Vec a, Vec b, Vec mask) { return _mm256_blendv_ps(a, b, mask); }
+    AVX2_OP bool any(Vec mask)                { return _mm256_movemask_ps(mask) != 0; }
+    AVX2_OP __m256i count(__m256i n, Vec alive) { return _mm256_sub_epi32(n, _mm256_castps_si256(alive)); }
+    AVX2_OP __m256i set1_count(unsigned int n)  { return _mm256_set1_epi32(static_cast<int>(n)); }
+    AVX2_OP void store_counts(__m256i n, unsigned int* out) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), n); }
+    #undef AVX2_OP
+};
+
+// Computing the escape time of 4 (double) or 8 (float) points at a time.
+// Every lane runs the same operations as escape_time<Formula>() in the same order, lanes
+// that escaped are masked out of the counter, and the group stops once all lanes escaped.
+// The target is avx2 only (no fma) so the compiler can't fuse the multiply-adds
+// and the iteration counts stay identical to the scalar loop.
+template<typename Formula, typename T>
+__attribute__((target("avx2")))
+static void escape_time_avx2(const T* cr, const T* ci, unsigned int* iterations, float* magnitudes, size_t count, const RenderSettings& settings)
+{
+    using Ops = Avx2Ops<T>;
+    using Vec = typename Ops::Vec;
+    constexpr size_t Lanes = Ops::Lanes;
+
+    const Vec four = Ops::set1(T(4));
+    const Vec julia_re = Ops::set1(static_cast<T>(settings.julia_re));
+    const Vec julia_im = Ops::set1(static_cast<T>(settings.julia_im));
+    const unsigned int limit = settings.max_iterations;
+    const __m256i max_iterations = Ops::set1_count(limit);
+
+    size_t i = 0;
+    for(; i + Lanes <= count; i += Lanes)
+    {
+        Vec zr = Ops::set1(T(0)), zi = Ops::set1(T(0));
+        Vec c_re = Ops::load(cr + i), c_im = Ops::load(ci + i);
+
+        if constexpr(Formula::PixelIsZ)
+        {
+            zr = c_re;
+            zi = c_im;
+            c_re = julia_re;
+            c_im = julia_im;
+        }
+
+        Vec zr2 = zr * zr, zi2 = zi * zi;
+        Vec saved_r = zr, saved_i = zi;
+        Vec escaped_at = Ops::set1(T(0));
+        __m256i n = _mm256_setzero_si256();
+
+        // Lanes inside the cardioid or the bulb start dead with max_iterations.
+        alignas(32) typename Ops::Int inside[Lanes] = {};
+        if(Formula::Interior && settings.cardioid_check)
+            for(size_t lane = 0; lane < Lanes; lane++)
+                inside[lane] = in_cardioid_or_bulb(cr[i + lane], ci[i + lane]) ? -1 : 0;
+
+        const __m256i interior = _mm256_load_si256(reinterpret_cast<const __m256i*>(inside));
+        n = _mm256_and_si256(interior, max_iterations);
+        Vec alive = reinterpret_cast<Vec>(_mm256_xor_si256(interior, _mm256_set1_epi64x(-1)));
+
+        unsigned int next_save = 1;
+
+        for(unsigned int iter = 0; iter < limit; iter++)
+        {
+            const Vec magnitude = zr2 + zi2;
+            const __m256i still = _mm256_and_si256(reinterpret_cast<__m256i>(alive), reinterpret_cast<__m256i>(Ops::less(magnitude, four)));
+
+            // Keeping |z|^2 of the lanes that escape on this iteration
+            if(magnitudes)
+                escaped_at = Ops::blend(escaped_at, magnitude, reinterpret_cast<Vec>(_mm256_andnot_si256(still, reinterpret_cast<__m256i>(alive))));
+
+            alive = reinterpret_cast<Vec>(still);
+
+            if(!Ops::any(alive))
+                break;
+
+            // Alive lanes are all ones (-1), so subtracting them counts one more iteration.
+            n = Ops::count(n, alive);
+
+            Formula::template step<Ops>(zr, zi, zr2, zi2, c_re, c_im);
+
+            zr2 = zr * zr;
+            zi2 = zi * zi;
+
+            // Same schedule as escape_time<Formula>(), all the lanes are on the same iteration.
+            if(settings.periodicity_check)
+            {
+                const __m256i periodic = _mm256_and_si256(reinterpret_cast<__m256i>(alive), _mm256_and_si256(
+                    reinterpret_cast<__m256i>(Ops::equal(zr, saved_r)), reinterpret_cast<__m256i>(Ops::equal(zi, saved_i))));
+
+                n = reinterpret_cast<__m256i>(Ops::blend(reinterpret_cast<Vec>(n), reinterpret_cast<Vec>(max_iterations), reinterpret_cast<Vec>(periodic)));
+                alive = reinterpret_cast<Vec>(_mm256_andnot_si256(periodic, reinterpret_cast<__m256i>(alive)));
+
+                if(iter + 1 == next_save)
+                {
+                    saved_r = zr;
+                    saved_i = zi;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        Ops::store_counts(n, iterations + i);
+
+        if(magnitudes)
+        {
+            T escaped[Lanes];
+            Ops::store(escaped, escaped_at);
+
+            for(size_t lane = 0; lane < Lanes; lane++)
+                magnitudes[i + lane] = static_cast<float>(escaped[lane]);
+        }
+    }
+
+    // the scalar tail and the caller run SSE code, clear the upper halves first
+    _mm256_zeroupper();
+    escape_time_scalar<Formula>(cr + i, ci + i, iterations + i, magnitudes ? magnitudes + i : nullptr, count - i, settings);
+}
+
+// GCC enables fma together with avx512f, so contraction is turned off explicitly
+// to keep the iteration counts identical to the scalar loop.
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+// The vector operations the AVX-512 kernel needs, for float (16 lanes) and double (8 lanes).
+// Lanes are tracked with mask registers.
+template<typename T> struct Avx512Ops;
+
+template<> struct Avx512Ops<double>
+{
+    using Vec  = __m512d;
+    using Mask = __mmask8;
+    static constexpr size_t Lanes = 8;
+
+    #define AVX512_OP __attribute__((target("avx512f"), always_inline)) static inline
+    AVX512_OP Vec set1(double value)                     { return _mm512_set1_pd(value); }
+    AVX512_OP Vec load(const double* values)             { return _mm512_loadu_pd(values); }
+    AVX512_OP void store(double* out, Vec a)             { _mm512_storeu_pd(out, a); }
+    AVX512_OP Vec blend(Vec a, Mask mask, Vec b)         { return _mm512_mask_mov_pd(a, mask, b); }
+    VECTOR_ARITH void abs(Vec& a)                          { a = reinterpret_cast<Vec>(reinterpret_cast<__m512i>(a) & ~reinterpret_cast<__m512i>(-Vec{})); }
+    AVX512_OP Mask less(Mask mask, Vec a, Vec b)         { return _mm512_mask_cmp_pd_mask(mask, a, b, _CMP_LT_OQ); }
+    AVX512_OP Mask equal(Mask mask, Vec a, Vec b)        { return _mm512_mask_cmp_pd_mask(mask, a, b, _CMP_EQ_OQ); }
+    AVX512_OP __m512i set1_count(unsigned int n)         { return _mm512_set1_epi64(n); }
+    AVX512_OP __m512i count(__m512i n, Mask alive)       { return _mm512_mask_add_epi64(n, alive, n, _mm512_set1_epi64(1)); }
+    AVX512_OP __m512i select(__m512i n, Mask mask, __m512i value) { return _mm512_mask_mov_epi64(n, mask, value); }
+    AVX512_OP void store_counts(__m512i n, unsigned int* out)
+    {
+        alignas(64) long long counts[Lanes];
+        _mm512_store_si512(counts, n);
+
+        for(size_t lane = 0; lane < Lanes; lane++)
+            out[lane] = static_cast<unsigned int>(counts[lane]);
+    }
+    #undef AVX512_OP
+};
+
+template<> struct Avx512Ops<float>
+{
+    using Vec  = __m512;
+    using Mask = __mmask16;
+    static constexpr size_t Lanes = 16;
+
+    #define AVX512_OP __attribute__((target("avx512f"), always_inline)) static inline
+    AVX512_OP Vec set1(float value)                      { return _mm512_set1_ps(value); }
+    AVX512_OP Vec load(const float* values)              { return _mm512_loadu_ps(values); }
+    AVX512_OP void store(float* out, Vec a)              { _mm512_storeu_ps(out, a); }
+    AVX512_OP Vec blend(Vec a, Mask mask, Vec b)         { return _mm512_mask_mov_ps(a, mask, b); }
+    VECTOR_ARITH void abs(Vec& a)                          { a = reinterpret_cast<Vec>(reinterpret_cast<__m512i>(a) & ~reinterpret_cast<__m512i>(-Vec{})); }
+    AVX512_OP Mask less(Mask mask, Vec a, Vec b)         { return _mm512_mask_cmp_ps_mask(mask, a, b, _CMP_LT_OQ); }
+    AVX512_OP Mask equal(Mask mask, Vec a, Vec b)        { return _mm512_mask_cmp_ps_mask(mask, a, b, _CMP_EQ_OQ); }
+    AVX512_OP __m512i set1_count(unsigned int n)         { return _mm512_set1_epi32(static_cast<int>(n)); }
+    AVX512_OP __m512i count(__m512i n, Mask alive)       { return _mm512_mask_add_epi32(n, alive, n, _mm512_set1_epi32(1)); }
+    AVX512_OP __m512i select(__m512i n, Mask mask, __m512i value) { return _mm512_mask_mov_epi32(n, mask, value); }
+    AVX512_OP void store_counts(__m512i n, unsigned int* out) { _mm512_storeu_si512(out, n); }
+    #undef AVX512_OP
+};
+
+// Computing the escape time of 8 (double) or 16 (float) points at a time, the lanes are tracked with a mask register.
+template<typename Formula, typename T>
+__attribute__((target("avx512f")))
+static void escape_time_avx512(const T* cr, const T* ci, unsigned int* iterations, float* magnitudes, size_t count, const RenderSettings& settings)
+{
+    using Ops  = Avx512Ops<T>;
+    using Vec  = typename Ops::Vec;
+    using Mask = typename Ops::Mask;
+    constexpr size_t Lanes = Ops::Lanes;
+
+    const Vec four = Ops::set1(T(4));
+    const Vec julia_re = Ops::set1(static_cast<T>(settings.julia_re));
+    const Vec julia_im = Ops::set1(static_cast<T>(settings.julia_im));
+    const unsigned int limit = settings.max_iterations;
+    const __m512i max_iterations = Ops::set1_count(limit);
+
+    size_t i = 0;
+    for(; i + Lanes <= count; i += Lanes)
+    {
+        Vec zr = Ops::set1(T(0)), zi = Ops::set1(T(0));
+        Vec c_re = Ops::load(cr + i), c_im = Ops::load(ci + i);
+
+        if constexpr(Formula::PixelIsZ)
+        {
+            zr = c_re;
+            zi = c_im;
+            c_re = julia_re;
+            c_im = julia_im;
+        }
+
+        Vec zr2 = zr * zr, zi2 = zi * zi;
+        Vec saved_r = zr, saved_i = zi;
+        Vec escaped_at = Ops::set1(T(0));
+
+        // Lanes inside the cardioid or the bulb start dead with max_iterations.
+        Mask interior = 0;
+        if(Formula::Interior && settings.cardioid_check)
+            for(unsigned int lane = 0; lane < Lanes; lane++)
+                if(in_cardioid_or_bulb(cr[i + lane], ci[i + lane]))
+                    interior |= static_cast<Mask>(1u << lane);
+
+        __m512i n = Ops::select(_mm512_setzero_si512(), interior, max_iterations);
+        Mask alive = static_cast<Mask>(~interior);
+
+        unsigned int next_save = 1;
+
+        for(unsigned int iter = 0; iter < limit; iter++)
+        {
+            const Vec magnitude = zr2 + zi2;
+            const Mask still = Ops::less(alive, magnitude, four);
+
+            // Keeping |z|^2 of the lanes that escape on this iteration
+            if(magnitudes)
+                escaped_at = Ops::blend(escaped_at, static_cast<Mask>(alive & ~still), magnitude);
+
+            alive = still;
+
+            if(alive == 0)
+                break;
+
+            n = Ops::count(n, alive);
+
+            Formula::template step<Ops>(zr, zi, zr2, zi2, c_re, c_im);
+
+            zr2 = zr * zr;
+            zi2 = zi * zi;
+
+            // Same schedule as escape_time<Formula>(), all the lanes are on the same iteration.
+            if(settings.periodicity_check)
+            {
+                const Mask periodic = Ops::equal(Ops::equal(alive, zr, saved_r), zi, saved_i);
+
+                n = Ops::select(n, periodic, max_iterations);
+                alive = static_cast<Mask>(alive & ~periodic);
+
+                if(iter + 1 == next_save)
+                {
+                    saved_r = zr;
+                    saved_i = zi;
+                    next_save *= 2;
+                }
+            }
+        }
+
+        Ops::store_counts(n, iterations + i);
+
+        if(magnitudes)
+        {
+            T escaped[Lanes];
+            Ops::store(escaped, escaped_at);
+
+            for(size_t lane = 0; lane < Lanes; lane++)
+                magnitudes[i + lane] = static_cast<float>(escaped[lane]);
         }
+    }
+
+    // the scalar tail and the caller run SSE code, clear the upper halves first
+    _mm256_zeroupper();
+    escape_time_scalar<Formula>(cr + i, ci + i, iterations + i, magnitudes ? magnitudes + i : nullptr, count - i, settings);
+}
+#pragma GCC pop_options
+#endif
+// --------------------------------------------------------------
+
+// Computing the escape time of count points with the chosen instruction set.
+// float and double have vector kernels, long double (and any ISA that isn't compiled in) uses the scalar loop.
+// magnitudes is optional, and receives |z|^2 of every point that escaped.
+template<typename Formula, typename T>
+static void escape_time_isa(const T* cr, const T* ci, unsigned int* iterations, float* magnitudes, size_t count, const RenderSettings& settings)
+{
+#ifdef MANDELBROT_X86_SIMD
+    if constexpr(std::is_same<T, float>::value || std::is_same<T, double>::value)
+    {
+        if(settings.isa == Isa::AVX512)
+            return escape_time_avx512<Formula>(cr, ci, iterations, magnitudes, count, settings);
+
+        if(settings.isa == Isa::AVX2)
+            return escape_time_avx2<Formula>(cr, ci, iterations, magnitudes, count, settings);
+    }
+#endif
+
+    escape_time_scalar<Formula>(cr, ci, iterations, magnitudes, count, settings);
+}
+
+// Finding the Multibrot kernel of the settings' power, the powers past MaxPower use the last one.
+template<unsigned int Power = 3, typename T>
+static void escape_time_multibrot(const T* cr, const T* ci, unsigned int* iterations, float* magnitudes, size_t count, const RenderSettings& settings)
+{
+    if constexpr(Power < MaxPower)
+        if(settings.power > Power)
+            return escape_time_multibrot<Power + 1>(cr, ci, iterations, magnitudes, count, settings);
+
+    escape_time_isa<Multibrot<Power>>(cr, ci, iterations, magnitudes, count, settings);
+}
+
+// Computing the escape time of count points with the settings' formula and instruction set.
+// The formula is picked once for the whole run of points, the kernels themselves have it compiled in.
+template<typename T>
+static void escape_time_n(const T* cr, const T* ci, unsigned int* iterations, float* magnitudes, size_t count, const RenderSettings& settings)
+{
+    switch(settings.fractal)
+    {
+        case Fractal::Julia:       return escape_time_isa<Julia>(cr, ci, iterations, magnitudes, count, settings);
+        case Fractal::Multibrot:   return escape_time_multibrot(cr, ci, iterations, magnitudes, count, settings);
+        case Fractal::BurningShip: return escape_time_isa<BurningShip>(cr, ci, iterations, magnitudes, count, settings);
+        default:                   return escape_time_isa<Mandelbrot>(cr, ci, iterations, magnitudes, count, settings);
+    }
+}
+// --------------------------------------------------------------
+
+// Raw result of a render, kept apart from the colours so the palette can change without iterating again.
+// Counts are capped at 65535. The fraction is where the smooth iteration count lies
+// between count and count + 1, in steps of 1/256.
+struct IterationBuffer
+{
+    static constexpr unsigned int MaxCount = 65535;
+
+    unsigned int width = 0, height = 0;
+    unsigned int max_iterations = MaxIterations;
+
+    std::vector<uint16_t> counts;
+    std::vector<uint8_t> fractions;
+
+    IterationBuffer() = default;
+
+    IterationBuffer(unsigned int width, unsigned int height, unsigned int max_iterations = MaxIterations)
+        : width(width), height(height), max_iterations(std::min(max_iterations, MaxCount)),
+          counts(static_cast<size_t>(width) * height, 0), fractions(static_cast<size_t>(width) * height, 0) {}
+
+    // Storing a pixel from its iteration count and |z|^2 at the escape.
+    // The smooth count is n + 1 - log2(log2(|z|)), so the fraction is 1 - log2(log2(|z|^2) / 2).
+    void set(size_t index, unsigned int n, float magnitude)
+    {
+        float fraction = 0.0f;
+
+        if(n < max_iterations)
+            fraction = std::min(std::max(1.0f - std::log2(0.5f * std::log2(magnitude)), 0.0f), 1.0f);
+
+        counts[index]    = static_cast<uint16_t>(std::min(n, max_iterations));
+        fractions[index] = static_cast<uint8_t>(fraction * 255.0f);
+    }
+};
+// --------------------------------------------------------------
+
+// Lookup table from iteration counts to RGBA colours, built from the 16 colours of pick_color().
+// Without smooth colouring there's one entry per count, with it there are 256 blended
+// steps between every two neighbouring colours. offset cycles the colours.
+// The last entry is the colour of the points inside the set.
+struct Palette
+{
+    bool smooth = false;
+    unsigned int offset = 0;
+    unsigned int max_iterations = MaxIterations;
+
+    std::vector<uint32_t> colors;
+};
+
+// Packing a colour in memory order, so a row of them is a row of RGBA bytes.
+static inline uint32_t pack_color(const sf::Color color)
+{
+    const uint8_t bytes[4] = { color.r, color.g, color.b, color.a };
+
+    uint32_t packed;
+    std::memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+}
+
+static Palette make_palette(unsigned int max_iterations, bool smooth, unsigned int offset)
+{
+    Palette palette;
+    palette.smooth = smooth;
+    palette.offset = offset;
+    palette.max_iterations = max_iterations;
+
+    if(!smooth)
+    {
+        for(unsigned int n = 0; n < max_iterations; n++)
+            palette.colors.push_back(pack_color(pick_color((n + offset) % 16)));
+    }
+    else
+    {
+        for(unsigned int n = 0; n < 16; n++)
+        {
+            const sf::Color from = pick_color((n + offset) % 16);
+            const sf::Color to   = pick_color((n + offset + 1) % 16);
+
+            for(unsigned int step = 0; step < 256; step++)
+            {
+                auto blend = [step](sf::Uint8 a, sf::Uint8 b) {
+                    return static_cast<sf::Uint8>((a * (256 - step) + b * step) / 256);
+                };
+
+                palette.colors.push_back(pack_color(sf::Color(blend(from.r, to.r), blend(from.g, to.g), blend(from.b, to.b))));
+            }
+        }
+    }
+
+    palette.colors.push_back(pack_color(sf::Color::Black));
+    return palette;
+}
+// --------------------------------------------------------------
+
+// Index of a pixel's colour in the palette.
+static inline uint32_t palette_index(const Palette& palette, uint16_t count, uint8_t fraction)
+{
+    if(!palette.smooth)
+        return std::min<uint32_t>(count, palette.max_iterations);
+
+    if(count >= palette.max_iterations)
+        return 16 * 256;
+
+    return ((count & 15u) << 8) | fraction;
+}
+
+// Colouring count pixels, one after another.
+static void colorize_scalar(const uint16_t* counts, const uint8_t* fractions, size_t count, const Palette& palette, uint32_t* pixels)
+{
+    for(size_t i = 0; i < count; i++)
+        pixels[i] = palette.colors[palette_index(palette, counts[i], fractions[i])];
+}
+
+#ifdef MANDELBROT_X86_SIMD
+// Colouring 8 pixels at a time, the palette indices are computed in vector registers
+// and the colours are fetched with a gather.
+__attribute__((target("avx2")))
+static void colorize_avx2(const uint16_t* counts, const uint8_t* fractions, size_t count, const Palette& palette, uint32_t* pixels)
+{
+    const int* table = reinterpret_cast<const int*>(palette.colors.data());
+
+    const __m256i max_iterations = _mm256_set1_epi32(static_cast<int>(palette.max_iterations));
+    const __m256i inside_index   = _mm256_set1_epi32(palette.smooth ? 16 * 256 : static_cast<int>(palette.max_iterations));
+    const __m256i low_bits       = _mm256_set1_epi32(15);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m256i n = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i)));
+        __m256i index = n;
+
+        if(palette.smooth)
+        {
+            const __m256i fraction = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(fractions + i)));
+            index = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(n, low_bits), 8), fraction);
+        }
+
+        // n >= max_iterations, the counts are 16 bit so the signed compare is safe
+        const __m256i inside = _mm256_cmpgt_epi32(n, _mm256_sub_epi32(max_iterations, _mm256_set1_epi32(1)));
+        index = _mm256_blendv_epi8(index, inside_index, inside);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_i32gather_epi32(table, index, 4));
+    }
+
+    _mm256_zeroupper();
+    colorize_scalar(counts + i, fractions + i, count - i, palette, pixels + i);
+}
+#endif
+// --------------------------------------------------------------
+
+// Turning the iteration buffer into RGBA pixels through the palette.
+// This is the only step that depends on the palette, so changing it is one pass over memory.
+static void colorize(const IterationBuffer& buffer, const Palette& palette, std::vector<uint32_t>& pixels, Isa isa)
+{
+    const size_t count = buffer.counts.size();
+    pixels.resize(count);
+
+#ifdef MANDELBROT_X86_SIMD
+    if(isa != Isa::Scalar)
+        return colorize_avx2(buffer.counts.data(), buffer.fractions.data(), count, palette, pixels.data());
+#endif
+
+    (void)isa;
+    colorize_scalar(buffer.counts.data(), buffer.fractions.data(), count, palette, pixels.data());
+}
+// --------------------------------------------------------------
+
+// Mapping from image pixels to the complex plane.
+// The whole picture is width x height pixels over [re_min, re_max] x [im_min, im_max],
+// and the image that is being rendered holds its rows from first_row on.
+template<typename T>
+struct Frame
+{
+    T re_min, re_max, im_min, im_max;
+    unsigned int width = Width, height = Height;
+    unsigned int first_row = 0;
+
+    // The same range on both axes
+    static Frame square(T min, T max) { return { min, max, min, max }; }
+
+    // Mandelbrot Zoom
+    T re(unsigned int x) const { return numeric_map(static_cast<T>(x), T(0), static_cast<T>(width), re_min, re_max); }
+    T im(unsigned int y) const { return numeric_map(static_cast<T>(first_row + y), T(0), static_cast<T>(height), im_min, im_max); }
+
+    template<typename U>
+    Frame<U> as() const
+    {
+        return { static_cast<U>(re_min), static_cast<U>(re_max), static_cast<U>(im_min), static_cast<U>(im_max), width, height, first_row };
+    }
+};
+
+// Checking whether T can tell the frame's pixels apart, at its largest coordinate on either axis.
+// The rounding step of T there has to be margin times smaller than a pixel, the default
+// 2^10 leaves room for the error that builds up over a short orbit.
+template<typename T>
+static bool precision_fits(const Frame<long double>& frame, long double margin = 1024.0L)
+{
+    const long double spacing = (frame.re_max - frame.re_min) / frame.width;
+    const long double largest = std::max({ std::fabs(frame.re_min), std::fabs(frame.re_max), std::fabs(frame.im_min), std::fabs(frame.im_max) });
+
+    return spacing >= margin * largest * std::numeric_limits<T>::epsilon();
+}
+
+// The margin for orbits up to the iteration limit, the rounding error builds up with
+// every iteration, so past 32 of them the margin grows with the limit.
+static long double iteration_margin(unsigned int iterations)
+{
+    return std::max(1024.0L, 32.0L * iterations);
+}
+
+// The cheapest precision for the frame at the settings' iteration limit,
+// frames beyond long double need the perturbation renderer (--deep).
+static Precision select_precision(const RenderSettings& settings, const Frame<long double>& frame)
+{
+    if(settings.precision != Precision::Auto)
+        return settings.precision;
+
+    const long double margin = iteration_margin(settings.inside_count());
+
+    if(precision_fits<float>(frame, margin))
+        return Precision::Float;
+
+    if(precision_fits<double>(frame, margin))
+        return Precision::Double;
+
+    return Precision::LongDouble;
+}
+// --------------------------------------------------------------
+
+// Rendering every pixel in the tile into the buffer, in the precision of T.
+// Tiles never overlap, so each worker writes to its own pixels only.
+template<typename T>
+static size_t render_tile(IterationBuffer& buffer, const Tile& tile, const Frame<T>& frame, const RenderSettings& settings)
+{
+    T cr[TileSize], ci[TileSize];
+    unsigned int iterations[TileSize];
+    float magnitudes[TileSize];
+
+    for(unsigned int y = tile.y; y < tile.y + tile.height; y++)
+    {
+        const T y_scaled = frame.im(y);
+
+        for(unsigned int x = 0; x < tile.width; x++)
+        {
+            cr[x] = frame.re(tile.x + x);
+            ci[x] = y_scaled;
+        }
+
+        escape_time_n(cr, ci, iterations, magnitudes, tile.width, settings);
+
+        for(unsigned int x = 0; x < tile.width; x++)
+            buffer.set(static_cast<size_t>(y) * buffer.width + tile.x + x, iterations[x], magnitudes[x]);
+    }
+
+    return static_cast<size_t>(tile.width) * tile.height;
+}
+// --------------------------------------------------------------
+
+// Mariani-Silver subdivision of a single tile.
+// The set is connected, so if the whole border of a rectangle has the same
+// iteration count, its inside is (almost always) the same too and can be filled
+// without computing it. Otherwise the rectangle is split into four and each part
+// is checked the same way, the split lines are shared so no pixel is computed twice.
+template<typename T>
+class TileSubdivision
+{
+public:
+    TileSubdivision(const Tile& tile, const Frame<T>& frame, const RenderSettings& settings)
+        : tile(tile), frame(frame), settings(settings) {}
+
+    // Rendering the tile into the buffer and returning the amount of pixels that were actually computed.
+    size_t render(IterationBuffer& buffer)
+    {
+        std::fill(std::begin(known), std::end(known), false);
+
+        subdivide(0, 0, tile.width - 1, tile.height - 1);
+        flush();
+
+        for(unsigned int y = 0; y < tile.height; y++)
+            for(unsigned int x = 0; x < tile.width; x++)
+                buffer.set(static_cast<size_t>(tile.y + y) * buffer.width + tile.x + x, counts[y * TileSize + x], magnitudes[y * TileSize + x]);
+
+        return computed;
+    }
+
+private:
+    // Below this size computing the inside is cheaper than splitting it again.
+    static constexpr unsigned int MinSize = 4;
+
+    void subdivide(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        // Computing the border
+        for(unsigned int x = x0; x <= x1; x++)
+        {
+            request(x, y0);
+            request(x, y1);
+        }
+
+        for(unsigned int y = y0 + 1; y < y1; y++)
+        {
+            request(x0, y);
+            request(x1, y);
+        }
+
+        flush();
+
+        if(x1 - x0 < 2 || y1 - y0 < 2)
+            return;
+
+        // Filling the inside when the border is uniform
+        const unsigned int border = counts[y0 * TileSize + x0];
+        bool uniform = true;
+
+        for(unsigned int x = x0; x <= x1 && uniform; x++)
+            uniform = counts[y0 * TileSize + x] == border && counts[y1 * TileSize + x] == border;
+
+        for(unsigned int y = y0 + 1; y < y1 && uniform; y++)
+            uniform = counts[y * TileSize + x0] == border && counts[y * TileSize + x1] == border;
+
+        if(uniform)
+        {
+            const float magnitude = magnitudes[y0 * TileSize + x0];
+
+            for(unsigned int y = y0 + 1; y < y1; y++)
+            {
+                for(unsigned int x = x0 + 1; x < x1; x++)
+                {
+                    counts[y * TileSize + x]     = border;
+                    magnitudes[y * TileSize + x] = magnitude;
+                    known[y * TileSize + x]      = true;
+                }
+            }
+
+            return;
+        }
+
+        // Computing the inside of small rectangles directly
+        if(x1 - x0 <= MinSize || y1 - y0 <= MinSize)
+        {
+            for(unsigned int y = y0 + 1; y < y1; y++)
+                for(unsigned int x = x0 + 1; x < x1; x++)
+                    request(x, y);
+
+            flush();
+            return;
+        }
+
+        // Splitting into four, the middle lines belong to both halves.
+        const unsigned int xm = (x0 + x1) / 2;
+        const unsigned int ym = (y0 + y1) / 2;
+
+        subdivide(x0, y0, xm, ym);
+        subdivide(xm, y0, x1, ym);
+        subdivide(x0, ym, xm, y1);
+        subdivide(xm, ym, x1, y1);
+    }
+
+    // Queuing a pixel for computation, pixels are computed in batches so the vector kernels stay full.
+    void request(unsigned int x, unsigned int y)
+    {
+        const unsigned int index = y * TileSize + x;
+
+        if(known[index])
+            return;
+
+        known[index] = true;
+
+        pending[pending_count] = index;
+        cr[pending_count] = frame.re(tile.x + x);
+        ci[pending_count] = frame.im(tile.y + y);
+
+        if(++pending_count == BatchSize)
+            flush();
+    }
+
+    // Computing all of the queued pixels.
+    void flush()
+    {
+        if(pending_count == 0)
+            return;
+
+        escape_time_n(cr, ci, iterations, escaped_at, pending_count, settings);
+
+        for(size_t i = 0; i < pending_count; i++)
+        {
+            counts[pending[i]]     = iterations[i];
+            magnitudes[pending[i]] = escaped_at[i];
+        }
+
+        computed += pending_count;
+        pending_count = 0;
+    }
+
+    static constexpr size_t BatchSize = 4 * TileSize;
+
+    const Tile tile;
+    const Frame<T> frame;
+    const RenderSettings& settings;
+
+    unsigned int counts[TileSize * TileSize];
+    float magnitudes[TileSize * TileSize];
+    bool known[TileSize * TileSize];
+
+    unsigned int pending[BatchSize];
+    T cr[BatchSize], ci[BatchSize];
+    unsigned int iterations[BatchSize];
+    float escaped_at[BatchSize];
+    size_t pending_count = 0;
+
+    size_t computed = 0;
+};
+// --------------------------------------------------------------
+
+// Rendering a tile with or without subdivision, returning the amount of pixels that were computed.
+template<typename T>
+static size_t compute_tile(IterationBuffer& buffer, const Tile& tile, const Frame<T>& frame, const RenderSettings& settings)
+{
+    if(settings.subdivision)
+        return TileSubdivision<T>(tile, frame, settings).render(buffer);
+
+    return render_tile<T>(buffer, tile, frame, settings);
+}
+// --------------------------------------------------------------
+
+// Pixels of the tile that reached a limit below the buffer's are inside the set as well.
+static void mark_inside(IterationBuffer& buffer, const Tile& tile, unsigned int limit)
+{
+    if(limit >= buffer.max_iterations)
+        return;
+
+    for(unsigned int y = tile.y; y < tile.y + tile.height; y++)
+    {
+        for(unsigned int x = tile.x; x < tile.x + tile.width; x++)
+        {
+            const size_t index = static_cast<size_t>(y) * buffer.width + x;
+
+            if(buffer.counts[index] >= limit)
+            {
+                buffer.counts[index]    = static_cast<uint16_t>(buffer.max_iterations);
+                buffer.fractions[index] = 0;
+            }
+        }
+    }
+}
+// --------------------------------------------------------------
+
+// Iteration limits picked for a frame, one for the whole frame and one for every tile.
+struct IterationBudget
+{
+    unsigned int frame = MaxIterations;
+    unsigned int tiles_x = 0;
+    std::vector<unsigned int> tiles;
+
+    unsigned int limit(const Tile& tile) const { return tiles[(tile.y / TileSize) * tiles_x + tile.x / TileSize]; }
+};
+// --------------------------------------------------------------
+
+// Rendering all of the tiles in the precision of T, with their own iteration limits when there's a budget.
+template<typename T>
+static void render_tiles(IterationBuffer& buffer, const Frame<T>& frame, WorkStealingPool& pool, const RenderSettings& settings,
+                         const IterationBudget* budget, std::vector<size_t>& computed_per_worker)
+{
+    pool.run(make_tiles(buffer.width, buffer.height), [&](const Tile& tile, unsigned int worker) {
+        if(!budget)
+        {
+            computed_per_worker[worker] += compute_tile<T>(buffer, tile, frame, settings);
+            return;
+        }
+
+        RenderSettings limited = settings;
+        limited.max_iterations = budget->limit(tile);
+
+        computed_per_worker[worker] += compute_tile<T>(buffer, tile, frame, limited);
+        mark_inside(buffer, tile, limited.max_iterations);
+    });
+}
+// --------------------------------------------------------------
+
+// Rendering rows [frame.first_row, frame.first_row + rows) of the picture into an iteration buffer,
+// in the precision select_precision() picks for the whole picture.
+static IterationBuffer render_band(const Frame<long double>& frame, unsigned int rows, WorkStealingPool& pool, const RenderSettings& settings,
+                                   const IterationBudget* budget, size_t* computed)
+{
+    IterationBuffer buffer(frame.width, rows, settings.inside_count());
+
+    // Every worker counts into its own slot
+    std::vector<size_t> computed_per_worker(pool.size(), 0);
+
+    // Start of the mandelbrot set
+    switch(select_precision(settings, frame))
+    {
+        case Precision::Float:
+            render_tiles(buffer, frame.as<float>(), pool, settings, budget, computed_per_worker);
+            break;
+
+        case Precision::Double:
+            render_tiles(buffer, frame.as<double>(), pool, settings, budget, computed_per_worker);
+            break;
+
+        default:
+            render_tiles(buffer, frame, pool, settings, budget, computed_per_worker);
+            break;
+    }
+
+    if(computed)
+        *computed = std::accumulate(computed_per_worker.begin(), computed_per_worker.end(), size_t(0));
+
+    return buffer;
+}
+// --------------------------------------------------------------
+
+// The iteration budget is picked from a probe at 1/ProbeScale of the resolution.
+constexpr unsigned int ProbeScale = 8;
+
+// While more than this part of the probe escapes in the last half of the limit, detail is still being lost.
+constexpr double LateFraction = 0.001;
+
+// No tile gets less than this.
+constexpr unsigned int MinimumBudget = 64;
+
+// Picking the iteration limits for rows [frame.first_row, frame.first_row + rows) of the frame.
+// The probe starts at the settings' max_iterations and goes up 4x at a time, up to the cap, while
+// too many of its pixels escape late or escape only with the higher limit. Then every tile gets twice the highest count that escaped
+// in and around it, or the whole limit when a probe there is inside the set: interior pixels
+// always cost the full limit, so the tiles far from the set only pay for what they need.
+static IterationBudget iteration_budget(const Frame<long double>& frame, unsigned int rows, WorkStealingPool& pool, const RenderSettings& settings)
+{
+    Frame<long double> probe = frame;
+    probe.width     = (frame.width + ProbeScale - 1) / ProbeScale;
+    probe.height    = (frame.height + ProbeScale - 1) / ProbeScale;
+    probe.first_row = frame.first_row / ProbeScale;
+    probe.re_max    = frame.re_min + (frame.re_max - frame.re_min) * (probe.width * ProbeScale) / frame.width;
+    probe.im_max    = frame.im_min + (frame.im_max - frame.im_min) * (probe.height * ProbeScale) / frame.height;
+
+    const unsigned int probe_rows = std::min((frame.first_row + rows + ProbeScale - 1) / ProbeScale, probe.height) - probe.first_row;
+
+    RenderSettings probe_settings = settings;
+    probe_settings.auto_iterations = false;
+    probe_settings.max_iterations  = std::min(settings.max_iterations, settings.iteration_cap);
+
+    IterationBuffer probes = render_band(probe, probe_rows, pool, probe_settings, nullptr, nullptr);
+    const double threshold = LateFraction * probes.counts.size();
+
+    while(probe_settings.max_iterations < settings.iteration_cap)
+    {
+        const unsigned int limit = probe_settings.max_iterations;
+        const size_t late   = std::count_if(probes.counts.begin(), probes.counts.end(), [&](unsigned int n) { return n >= limit / 2 && n < limit; });
+        const size_t inside = std::count_if(probes.counts.begin(), probes.counts.end(), [&](unsigned int n) { return n >= limit; });
+
+        if(late <= threshold && inside <= threshold)
+            break;
+
+        // Without late escapes the higher limit is only kept when some of the inside pixels escape with it,
+        // the rest of them are really inside the set (or too deep to matter).
+        RenderSettings higher = probe_settings;
+        higher.max_iterations = std::min(limit * 4, settings.iteration_cap);
+
+        IterationBuffer more = render_band(probe, probe_rows, pool, higher, nullptr, nullptr);
+        const size_t still_inside = std::count_if(more.counts.begin(), more.counts.end(), [&](unsigned int n) { return n >= higher.max_iterations; });
+
+        if(late <= threshold && inside - still_inside <= threshold)
+            break;
+
+        probe_settings = higher;
+        probes = std::move(more);
+    }
+
+    const unsigned int limit = probe_settings.max_iterations;
+
+    // The limit some of the probe pixels need
+    auto needed = [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) {
+        unsigned int highest = 0;
+
+        for(unsigned int y = y0; y < y1; y++)
+        {
+            for(unsigned int x = x0; x < x1; x++)
+            {
+                const unsigned int n = probes.counts[static_cast<size_t>(y) * probes.width + x];
+
+                if(n >= limit)
+                    return limit;
+
+                highest = std::max(highest, n);
+            }
+        }
+
+        return std::min(std::max(2 * highest, MinimumBudget), limit);
+    };
+
+    IterationBudget budget;
+    budget.frame   = needed(0, 0, probes.width, probes.height);
+    budget.tiles_x = (frame.width + TileSize - 1) / TileSize;
+
+    // Every tile and its neighbours, in probe pixels
+    for(unsigned int ty = 0; ty < (rows + TileSize - 1) / TileSize; ty++)
+    {
+        const unsigned int y0 = (frame.first_row + (ty > 0 ? ty - 1 : 0) * TileSize) / ProbeScale - probe.first_row;
+        const unsigned int y1 = std::min((frame.first_row + (ty + 2) * TileSize + ProbeScale - 1) / ProbeScale - probe.first_row, probes.height);
+
+        for(unsigned int tx = 0; tx < budget.tiles_x; tx++)
+        {
+            const unsigned int x0 = (tx > 0 ? tx - 1 : 0) * TileSize / ProbeScale;
+            const unsigned int x1 = std::min((tx + 2) * TileSize / ProbeScale, probes.width);
+
+            budget.tiles.push_back(needed(x0, y0, x1, y1));
+        }
+    }
+
+    return budget;
+}
+// --------------------------------------------------------------
+
+// Rendering rows [frame.first_row, frame.first_row + rows) of the picture into an iteration buffer,
+// with the iteration limits picked per tile when the settings ask for it.
+// When computed isn't null, it receives the amount of pixels that went through the kernel.
+static IterationBuffer mandelbrot_band(const Frame<long double>& frame, unsigned int rows, WorkStealingPool& pool, const RenderSettings& settings, size_t* computed = nullptr)
+{
+    if(!settings.auto_iterations)
+        return render_band(frame, rows, pool, settings, nullptr, computed);
+
+    const IterationBudget budget = iteration_budget(frame, rows, pool, settings);
+    return render_band(frame, rows, pool, settings, &budget, computed);
+}
+// --------------------------------------------------------------
+
+// Rendering the view into a Width x Height iteration buffer.
+static IterationBuffer mandelbrot_set(long double min, long double max, WorkStealingPool& pool, const RenderSettings& settings, size_t* computed = nullptr)
+{
+    return mandelbrot_band(Frame<long double>::square(min, max), Height, pool, settings, computed);
+}
+// --------------------------------------------------------------
+
+// Rendering a picture too big for memory (e.g. 65536 x 65536) straight into a binary PPM file.
+// The picture is rendered in bands of band_rows rows on the pool, and while a band is
+// computed the previous one is written out, so at most two bands are in memory at a time.
+// PPM rows have a fixed size, so when the file already holds the start of the same picture
+// (same header) the render resumes after the last band that was completely written.
+// The header holds every setting that changes the picture, a file rendered with other
+// settings is left alone.
+static bool stream_render(const std::string& path, unsigned int width, unsigned int height, long double min, long double max,
+                          unsigned int band_rows, WorkStealingPool& pool, const RenderSettings& settings, const Palette& palette)
+{
+    const std::string signature = "P6\n# mandelbrot_set ";
+
+    Frame<long double> view = Frame<long double>::square(min, max);
+    view.width  = width;
+    view.height = height;
+
+    std::ostringstream header_text;
+    header_text << std::setprecision(std::numeric_limits<long double>::max_digits10)
+                << signature << min << ' ' << max << '\n'
+                << "# " << fractal_name(settings.fractal);
+
+    if(settings.fractal == Fractal::Julia)
+        header_text << ' ' << settings.julia_re << ' ' << settings.julia_im;
+    else if(settings.fractal == Fractal::Multibrot)
+        header_text << ' ' << settings.power;
+
+    header_text << ", " << precision_name(select_precision(settings, view))
+                << (settings.auto_iterations ? ", auto-iterations " : ", iterations ") << settings.inside_count()
+                << (settings.subdivision ? ", subdivided" : "") << (palette.smooth ? ", smooth" : "") << '\n'
+                << width << ' ' << height << "\n255\n";
+
+    const std::string header   = header_text.str();
+    const uint64_t row_bytes   = static_cast<uint64_t>(width) * 3;
+    const unsigned int bands   = (height + band_rows - 1) / band_rows;
+
+    // Counting the bands that are already on disk
+    unsigned int first_band = 0;
+    {
+        std::ifstream existing(path, std::ios::binary);
+
+        std::string on_disk(header.size(), '\0');
+        existing.read(&on_disk[0], static_cast<std::streamsize>(on_disk.size()));
+        on_disk.resize(static_cast<size_t>(existing.gcount()));
+
+        if(on_disk == header)
+        {
+            const uint64_t data = std::filesystem::file_size(path) - header.size();
+            first_band = data >= row_bytes * height ? bands : static_cast<unsigned int>(data / row_bytes / band_rows);
+        }
+        else if(on_disk.compare(0, signature.size(), signature) == 0)
+        {
+            std::cerr << path << " was rendered with other settings, it's not resumed or overwritten" << std::endl;
+            return false;
+        }
+    }
+
+    if(first_band == bands)
+    {
+        std::cout << path << " is already complete" << std::endl;
+        return true;
+    }
+
+    // Dropping the partially written band, or starting a new file
+    std::ofstream file;
+
+    if(first_band > 0)
+    {
+        std::filesystem::resize_file(path, header.size() + row_bytes * band_rows * first_band);
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+        std::cout << "Resuming " << path << " from band " << first_band << "/" << bands << std::endl;
+    }
+    else
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        file << header;
+    }
+
+    if(!file)
+    {
+        std::cerr << "Can't open " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Rendering " << width << "x" << height << " with "
+              << precision_name(select_precision(settings, view)) << " precision" << std::endl;
+
+    std::future<bool> writing;
+
+    for(unsigned int band = first_band; band < bands; band++)
+    {
+        Frame<long double> frame = view;
+        frame.first_row = band * band_rows;
+
+        const unsigned int rows = std::min(band_rows, height - frame.first_row);
+
+        size_t computed = 0;
+        const IterationBuffer buffer = mandelbrot_band(frame, rows, pool, settings, &computed);
+
+        std::vector<uint32_t> colors;
+        colorize(buffer, palette, colors, settings.isa);
+
+        // RGBA to RGB
+        std::vector<uint8_t> pixels(row_bytes * rows);
+        const uint8_t* rgba = reinterpret_cast<const uint8_t*>(colors.data());
+
+        for(size_t i = 0; i < colors.size(); i++)
+            std::copy(rgba + i * 4, rgba + i * 4 + 3, pixels.begin() + i * 3);
+
+        // Waiting for the previous band before handing this one to the writer
+        if(writing.valid() && !writing.get())
+            return false;
+
+        writing = std::async(std::launch::async, [&file, pixels = std::move(pixels), band, bands, computed, total = buffer.counts.size()]() {
+            file.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+            file.flush();
+
+            std::cout << "Band " << band + 1 << "/" << bands << " written, computed " << computed << " of " << total << " pixels" << std::endl;
+            return static_cast<bool>(file);
+        });
+    }
+
+    return !writing.valid() || writing.get();
+}
+// --------------------------------------------------------------
+// Exponential map (log-polar) of the plane around a zoom center.
+// Sample (a, k) is the point center + e^(rho_top - k * step) * e^(i * a * step), so its rows go
+// down in radius and every row has the same amount of samples around the center.
+// A frame zoomed in by 2x is the same part of the map moved down by rows_per_octave rows,
+// so a whole zoom is rendered once, one octave (strip) of rows at a time, and every frame
+// of the animation is looked up from the strips instead of being iterated again.
+struct ExponentialMap
+{
+    long double center_re, center_im;
+    long double rho_top;
+
+    // Angles around the circle, and rows for a factor 2 of radius
+    unsigned int angles, rows_per_octave;
+    double step;
+
+    // Samples never need to be closer than a pixel of the last frame.
+    long double min_spacing;
+
+    std::vector<double> cosines, sines;
+
+    long double radius(unsigned int row) const { return std::exp(rho_top - static_cast<long double>(row) * step); }
+};
+
+// A map with at least one sample per pixel at the corners of a width x height frame,
+// starting at the corners of the frame with the given radius (half of its width).
+static ExponentialMap exponential_map(long double center_re, long double center_im, long double radius, long double min_spacing, unsigned int width, unsigned int height)
+{
+    const double corner = std::hypot(width / 2.0, height / 2.0);
+    const double pi = std::acos(-1.0);
+
+    ExponentialMap map;
+    map.center_re   = center_re;
+    map.center_im   = center_im;
+    map.angles      = (static_cast<unsigned int>(std::ceil(2.0 * pi * corner)) + TileSize - 1) / TileSize * TileSize;
+    map.rows_per_octave = static_cast<unsigned int>(std::ceil(std::log(2.0) * map.angles / (2.0 * pi)));
+    map.step        = std::log(2.0) / map.rows_per_octave;
+    map.rho_top     = std::log(2.0L * radius / width * corner) + map.step;
+    map.min_spacing = min_spacing;
+
+    for(unsigned int a = 0; a < map.angles; a++)
+    {
+        map.cosines.push_back(std::cos(2.0 * pi * a / map.angles));
+        map.sines.push_back(std::sin(2.0 * pi * a / map.angles));
+    }
+
+    return map;
+}
+// --------------------------------------------------------------
+
+// Rendering a block of the strip in the precision of T, like render_tile() does for frames.
+template<typename T>
+static void render_strip_tile(IterationBuffer& strip, const Tile& tile, const ExponentialMap& map, unsigned int octave, const RenderSettings& settings)
+{
+    T cr[TileSize], ci[TileSize];
+    unsigned int iterations[TileSize];
+    float magnitudes[TileSize];
+
+    for(unsigned int y = tile.y; y < tile.y + tile.height; y++)
+    {
+        const long double radius = map.radius(octave * map.rows_per_octave + y);
+
+        for(unsigned int x = 0; x < tile.width; x++)
+        {
+            cr[x] = static_cast<T>(map.center_re + radius * map.cosines[tile.x + x]);
+            ci[x] = static_cast<T>(map.center_im + radius * map.sines[tile.x + x]);
+        }
+
+        escape_time_n(cr, ci, iterations, magnitudes, tile.width, settings);
+
+        for(unsigned int x = 0; x < tile.width; x++)
+            strip.set(static_cast<size_t>(y) * strip.width + tile.x + x, iterations[x], magnitudes[x]);
+    }
+}
+
+// Rendering one octave of rows of the map on the pool.
+static IterationBuffer render_strip(const ExponentialMap& map, unsigned int octave, WorkStealingPool& pool, const RenderSettings& settings)
+{
+    IterationBuffer strip(map.angles, map.rows_per_octave, settings.max_iterations);
+
+    // The precision that tells the innermost row's samples apart
+    const long double inner   = map.radius((octave + 1) * map.rows_per_octave - 1);
+    const long double spacing = std::max(inner * static_cast<long double>(map.step), map.min_spacing);
+    const long double largest = std::max(std::fabs(map.center_re), std::fabs(map.center_im)) + map.radius(octave * map.rows_per_octave);
+
+    // One pixel as wide as the samples are apart, at the largest coordinate
+    Frame<long double> sample = Frame<long double>::square(largest - spacing, largest);
+    sample.width = 1;
+
+    const Precision precision = select_precision(settings, sample);
+
+    pool.run(make_tiles(strip.width, strip.height), [&](const Tile& tile, unsigned int) {
+        switch(precision)
+        {
+            case Precision::Float:
+                render_strip_tile<float>(strip, tile, map, octave, settings);
+                break;
+
+            case Precision::Double:
+                render_strip_tile<double>(strip, tile, map, octave, settings);
+                break;
+
+            default:
+                render_strip_tile<long double>(strip, tile, map, octave, settings);
+                break;
+        }
+    });
+
+    return strip;
+}
+// --------------------------------------------------------------
+
+// Rendering a zoom from the whole set (radius 2) into the center, down to end_radius,
+// as frames PNG files in directory. The frames are looked up from an exponential map,
+// whose strips are rendered on the pool as the zoom reaches them and dropped once it's past them.
+// While a frame is built the previous ones are encoded, up to Encoders of them at a time.
+// The palette has to be made for the settings' max_iterations.
+static bool render_animation(const std::string& directory, long double center_re, long double center_im, long double end_radius, unsigned int frames,
+                             unsigned int width, unsigned int height, WorkStealingPool& pool, const RenderSettings& settings, const Palette& palette)
+{
+    constexpr long double StartRadius = 2;
+    constexpr size_t Encoders = 4;
+
+    if(frames == 0 || end_radius <= 0 || end_radius > StartRadius)
+    {
+        std::cerr << "The zoom needs at least one frame and an end radius in (0, 2]" << std::endl;
+        return false;
+    }
+
+    const long double end_spacing = 2.0L * end_radius / width;
+    const long double largest     = std::max(std::fabs(center_re), std::fabs(center_im)) + end_radius;
+
+    Frame<long double> last_sample = Frame<long double>::square(largest - end_spacing, largest);
+    last_sample.width = 1;
+
+    if(!precision_fits<long double>(last_sample))
+    {
+        std::cerr << "The last frame is too deep for long double" << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    const ExponentialMap map = exponential_map(center_re, center_im, StartRadius, end_spacing, width, height);
+
+    // Strips are shared by frames of every depth, so the whole zoom has one iteration limit
+    RenderSettings fixed = settings;
+    fixed.auto_iterations = false;
+
+    // Where every pixel is in the map, relative to the frame: its angle and its distance in rows.
+    // The center pixel is taken as half a pixel away.
+    std::vector<unsigned int> pixel_angles(static_cast<size_t>(width) * height);
+    std::vector<double> pixel_rows(pixel_angles.size());
+    double corner_rows = 0.0;
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            const double dx = x - width / 2.0, dy = y - height / 2.0;
+            const long angle = std::lround(std::atan2(dy, dx) / (2.0 * std::acos(-1.0)) * map.angles);
+
+            pixel_angles[static_cast<size_t>(y) * width + x] = static_cast<unsigned int>((angle + map.angles) % map.angles);
+            pixel_rows[static_cast<size_t>(y) * width + x]   = std::log(std::max(std::hypot(dx, dy), 0.5)) / map.step;
+
+            corner_rows = std::max(corner_rows, pixel_rows[static_cast<size_t>(y) * width + x]);
+        }
+    }
+
+    std::cout << "Zooming in " << frames << " frames through a " << map.angles << "x" << map.rows_per_octave << " map per octave" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // The strips that are still in use, the first one is octave first_strip
+    std::deque<IterationBuffer> strips;
+    unsigned int first_strip = 0, rendered = 0;
+
+    std::deque<std::future<bool>> encoding;
+
+    for(unsigned int n = 0; n < frames; n++)
+    {
+        const long double t       = frames > 1 ? static_cast<long double>(n) / (frames - 1) : 0.0L;
+        const long double radius  = std::exp(std::log(StartRadius) + t * (std::log(end_radius) - std::log(StartRadius)));
+        const long double spacing = 2.0L * radius / width;
+
+        // Row of the map at one pixel from the frame's center
+        const double base = static_cast<double>((map.rho_top - std::log(spacing)) / map.step);
+
+        const unsigned int first_row = static_cast<unsigned int>(std::max(0.0, std::floor(base - corner_rows)));
+        const unsigned int last_row  = static_cast<unsigned int>(std::ceil(base - std::log(0.5) / map.step));
+
+        while((first_strip + strips.size()) * map.rows_per_octave <= last_row)
+        {
+            strips.push_back(render_strip(map, first_strip + static_cast<unsigned int>(strips.size()), pool, fixed));
+            rendered++;
+        }
+
+        while((first_strip + 1) * map.rows_per_octave <= first_row)
+        {
+            strips.pop_front();
+            first_strip++;
+        }
+
+        // Looking every pixel up in the map
+        IterationBuffer frame(width, height, fixed.max_iterations);
+
+        for(size_t i = 0; i < pixel_rows.size(); i++)
+        {
+            const unsigned int row = std::min(static_cast<unsigned int>(std::max(std::lround(base - pixel_rows[i]), 0L)), last_row);
+            const IterationBuffer& strip = strips[row / map.rows_per_octave - first_strip];
+            const size_t index = static_cast<size_t>(row % map.rows_per_octave) * strip.width + pixel_angles[i];
+
+            frame.counts[i]    = strip.counts[index];
+            frame.fractions[i] = strip.fractions[index];
+        }
+
+        std::vector<uint32_t> colors;
+        colorize(frame, palette, colors, fixed.isa);
+
+        // Waiting for the oldest frame when all of the encoders are busy
+        if(encoding.size() == Encoders)
+        {
+            if(!encoding.front().get())
+                return false;
+
+            encoding.pop_front();
+        }
+
+        std::ostringstream path;
+        path << directory << "/frame_" << std::setw(5) << std::setfill('0') << n << ".png";
+
+        encoding.push_back(std::async(std::launch::async, [colors = std::move(colors), file = path.str(), width, height]() {
+            sf::Image image;
+            image.create(width, height, reinterpret_cast<const sf::Uint8*>(colors.data()));
+            return image.saveToFile(file);
+        }));
+
+        std::cout << "Frame " << n + 1 << "/" << frames << ", " << rendered << " strips rendered" << std::endl;
+    }
+
+    for(auto& encoded : encoding)
+        if(!encoded.get())
+            return false;
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double samples = static_cast<double>(rendered) * map.angles * map.rows_per_octave;
+
+    std::cout << "Rendered in " << elapsed.count() << " s, " << samples / (static_cast<double>(frames) * width * height)
+              << " samples per frame pixel" << std::endl;
+
+    return true;
+}
+// --------------------------------------------------------------
+// Orbit density (Buddhabrot) rendering: instead of colouring c by its escape time,
+// every point on the orbits of the c values that escape is counted in a histogram of the view.
+// The nebula version has a channel per iteration limit, the settings' max_iterations divided by
+// NebulaDivisors, and an orbit counts in every channel whose limit it escapes within.
+constexpr unsigned int NebulaDivisors[3] = { 1, 5, 20 };
+
+// The c values are sampled from [-2, 2] on both axes, split into ImportanceCells x ImportanceCells cells.
+constexpr unsigned int ImportanceCells = 256;
+
+// Samples are drawn in batches, a batch is a single pool job with its own random sequence.
+constexpr unsigned int BatchSamples = 1 << 16;
+constexpr unsigned int RoundBatches = 256;
+
+// A cell is picked with a probability proportional to the amount of orbit points its c values
+// were seen to produce, so little time goes to cells inside the set or ones that escape at once.
+// Every sample is weighted by 1 / (cells * probability) so the picture stays the same as with uniform sampling.
+struct ImportanceMap
+{
+    std::vector<double> cumulative;
+    std::vector<float> weights;
+
+    size_t pick(double u) const
+    {
+        const size_t cell = std::upper_bound(cumulative.begin(), cumulative.end(), u * cumulative.back()) - cumulative.begin();
+        return std::min(cell, cumulative.size() - 1);
+    }
+};
+
+// Probing every cell with Probes x Probes escape times.
+// Cells where no probe escaped still get a small share, they may hold escaping c values the probes missed.
+static ImportanceMap importance_map(WorkStealingPool& pool, const RenderSettings& settings)
+{
+    constexpr unsigned int Probes = 4;
+
+    Frame<long double> frame = Frame<long double>::square(-2, 2);
+    frame.width = frame.height = ImportanceCells * Probes;
+
+    const IterationBuffer probes = mandelbrot_band(frame, frame.height, pool, settings);
+
+    std::vector<double> cells(static_cast<size_t>(ImportanceCells) * ImportanceCells, 0.0);
+
+    for(unsigned int y = 0; y < frame.height; y++)
+    {
+        for(unsigned int x = 0; x < frame.width; x++)
+        {
+            const unsigned int n = probes.counts[static_cast<size_t>(y) * frame.width + x];
+
+            if(n < probes.max_iterations)
+                cells[(y / Probes) * ImportanceCells + x / Probes] += n;
+        }
+    }
+
+    const double floor = 0.01 * std::accumulate(cells.begin(), cells.end(), 0.0) / cells.size();
+
+    ImportanceMap map;
+    double total = 0.0;
+
+    for(double& cell : cells)
+    {
+        cell  = std::max(cell, floor);
+        total += cell;
+        map.cumulative.push_back(total);
+    }
+
+    for(const double cell : cells)
+        map.weights.push_back(static_cast<float>(total / (cells.size() * cell)));
+
+    return map;
+}
+// --------------------------------------------------------------
+
+// Rendering an orbit density picture of the view [min, max] from the given amount of samples.
+// Every worker adds into its own histogram, so there's no contention, and after every round
+// of batches the histograms are merged into the total (in double, the worker's are float).
+static std::vector<uint32_t> buddhabrot(uint64_t samples, bool nebula, unsigned int width, unsigned int height, long double min, long double max,
+                                        WorkStealingPool& pool, const RenderSettings& settings)
+{
+    const unsigned int channels = nebula ? 3 : 1;
+    const size_t pixels = static_cast<size_t>(width) * height;
+
+    const auto start = std::chrono::steady_clock::now();
+    const ImportanceMap map = importance_map(pool, settings);
+
+    std::vector<std::vector<float>> histograms(pool.size(), std::vector<float>(pixels * channels, 0.0f));
+    std::vector<double> total(pixels * channels, 0.0);
+    std::vector<uint64_t> escaped_per_worker(pool.size(), 0);
+
+    const double origin   = static_cast<double>(min);
+    const double re_scale = width / static_cast<double>(max - min);
+    const double im_scale = height / static_cast<double>(max - min);
+    const double cell_size = 4.0 / ImportanceCells;
+
+    const uint64_t batches = (samples + BatchSamples - 1) / BatchSamples;
+
+    for(uint64_t first = 0; first < batches; first += RoundBatches)
+    {
+        const unsigned int round = static_cast<unsigned int>(std::min<uint64_t>(RoundBatches, batches - first));
+
+        // Pool jobs are tiles, here a tile's x is just the index of the batch in the round.
+        std::vector<Tile> jobs;
+        for(unsigned int i = 0; i < round; i++)
+            jobs.push_back({ i, 0, 1, 1 });
+
+        pool.run(jobs, [&](const Tile& job, unsigned int worker) {
+            constexpr unsigned int Chunk = 256;
+
+            std::mt19937_64 random(first + job.x);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+            float* histogram = histograms[worker].data();
+
+            double cr[Chunk], ci[Chunk];
+            float weights[Chunk];
+            unsigned int iterations[Chunk];
+
+            for(unsigned int done = 0; done < BatchSamples; done += Chunk)
+            {
+                for(unsigned int i = 0; i < Chunk; i++)
+                {
+                    const size_t cell = map.pick(uniform(random));
+
+                    cr[i] = -2.0 + (cell % ImportanceCells + uniform(random)) * cell_size;
+                    ci[i] = -2.0 + (cell / ImportanceCells + uniform(random)) * cell_size;
+                    weights[i] = map.weights[cell];
+                }
+
+                // The kernel rejects the c values that never escape, with the interior shortcuts
+                escape_time_n(cr, ci, iterations, nullptr, Chunk, settings);
+
+                for(unsigned int i = 0; i < Chunk; i++)
+                {
+                    const unsigned int n = iterations[i];
+
+                    if(n >= settings.max_iterations)
+                        continue;
+
+                    escaped_per_worker[worker]++;
+
+                    // The orbit counts in the channels up to the last limit it escapes within
+                    unsigned int last_channel = 0;
+                    while(nebula && last_channel < 2 && n < settings.max_iterations / NebulaDivisors[last_channel + 1])
+                        last_channel++;
+
+                    double zr = 0.0, zi = 0.0;
+
+                    for(unsigned int k = 0; k < n; k++)
+                    {
+                        const double next_i = 2.0 * zr * zi + ci[i];
+                        zr = zr * zr - zi * zi + cr[i];
+                        zi = next_i;
+
+                        const double x = (zr - origin) * re_scale;
+                        const double y = (zi - origin) * im_scale;
+
+                        if(x < 0.0 || y < 0.0 || x >= width || y >= height)
+                            continue;
+
+                        const size_t index = static_cast<size_t>(y) * width + static_cast<size_t>(x);
+
+                        for(unsigned int channel = 0; channel <= last_channel; channel++)
+                            histogram[channel * pixels + index] += weights[i];
+                    }
+                }
+            }
+        });
+
+        for(auto& histogram : histograms)
+        {
+            for(size_t i = 0; i < histogram.size(); i++)
+                total[i] += histogram[i];
+
+            std::fill(histogram.begin(), histogram.end(), 0.0f);
+        }
+
+        std::cout << "Sampled " << std::min(samples, (first + round) * BatchSamples) << "/" << samples << std::endl;
+    }
+
+    const uint64_t escaped = std::accumulate(escaped_per_worker.begin(), escaped_per_worker.end(), uint64_t(0));
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Rendered in " << elapsed.count() << " s, " << batches * BatchSamples / elapsed.count() / 1e6 << " million samples per second, "
+              << 100.0 * escaped / (batches * BatchSamples) << "% of them escaped" << std::endl;
+
+    // Square root tone mapping, every channel against its own brightest pixel
+    double brightest[3];
+    for(unsigned int channel = 0; channel < channels; channel++)
+        brightest[channel] = std::max(*std::max_element(total.begin() + channel * pixels, total.begin() + (channel + 1) * pixels), 1e-30);
+
+    std::vector<uint32_t> colors(pixels);
+
+    for(size_t i = 0; i < pixels; i++)
+    {
+        uint8_t values[3];
+
+        for(unsigned int channel = 0; channel < 3; channel++)
+        {
+            const unsigned int source = std::min(channel, channels - 1);
+            values[channel] = static_cast<uint8_t>(255.0 * std::sqrt(total[source * pixels + i] / brightest[source]));
+        }
+
+        colors[i] = pack_color(sf::Color(values[0], values[1], values[2]));
+    }
+
+    return colors;
+}
+// --------------------------------------------------------------
+
+// Signed fixed-point number with one 32-bit integer limb and any amount of 32-bit fraction limbs.
+// The limbs are two's complement, least significant first. Only the operations
+// the reference orbit needs are implemented, and products are truncated.
+class BigFixed
+{
+public:
+    explicit BigFixed(size_t fraction_limbs = 1)
+        : limbs(fraction_limbs + 1, 0) {}
+
+    // Parsing a decimal number such as "-0.7436438870371587047521915", anything else
+    // (exponents, other characters, an integer part beyond the limb) throws std::invalid_argument.
+    static BigFixed parse(const std::string& text, size_t fraction_limbs)
+    {
+        BigFixed result(fraction_limbs);
+
+        const bool negative = !text.empty() && text[0] == '-';
+        const size_t begin  = (!text.empty() && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+        const size_t point  = std::min(text.find('.', begin), text.size());
+
+        const auto digits = [&](size_t first, size_t last) {
+            return std::all_of(text.begin() + static_cast<std::ptrdiff_t>(first), text.begin() + static_cast<std::ptrdiff_t>(last),
+                               [](char c) { return c >= '0' && c <= '9'; });
+        };
+
+        const size_t digit_count = text.size() - begin - (point < text.size() ? 1 : 0);
+
+        if(digit_count == 0 || !digits(begin, point) || (point < text.size() && !digits(point + 1, text.size())))
+            throw std::invalid_argument("not a decimal number: " + text);
+
+        uint32_t integer = 0;
+        for(size_t i = begin; i < point; i++)
+        {
+            integer = integer * 10 + static_cast<uint32_t>(text[i] - '0');
+
+            if(integer > static_cast<uint32_t>(std::numeric_limits<int32_t>::max()))
+                throw std::invalid_argument("out of range: " + text);
+        }
+
+        // Horner's method from the last digit: fraction = (fraction + digit) / 10
+        for(size_t i = text.size(); i > point + 1; i--)
+        {
+            result.limbs.back() = static_cast<uint32_t>(text[i - 1] - '0');
+            result.divide(10);
+        }
+
+        result.limbs.back() = integer;
+        return negative ? result.negated() : result;
+    }
+
+    double to_double() const
+    {
+        const BigFixed magnitude = is_negative() ? negated() : *this;
+        const size_t fraction_limbs = limbs.size() - 1;
+
+        double value = 0.0;
+        for(size_t i = 0; i < limbs.size(); i++)
+            value += std::ldexp(static_cast<double>(magnitude.limbs[i]), 32 * (static_cast<int>(i) - static_cast<int>(fraction_limbs)));
+
+        return is_negative() ? -value : value;
+    }
+
+    BigFixed operator+(const BigFixed& other) const
+    {
+        BigFixed result(limbs.size() - 1);
+        uint64_t carry = 0;
+
+        for(size_t i = 0; i < limbs.size(); i++)
+        {
+            carry += static_cast<uint64_t>(limbs[i]) + other.limbs[i];
+            result.limbs[i] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+
+        return result;
+    }
+
+    BigFixed operator-(const BigFixed& other) const { return *this + other.negated(); }
+
+    BigFixed operator*(const BigFixed& other) const
+    {
+        const BigFixed a = is_negative() ? negated() : *this;
+        const BigFixed b = other.is_negative() ? other.negated() : other;
+
+        // Schoolbook multiplication, then dropping the extra fraction limbs.
+        const size_t size = limbs.size();
+        std::vector<uint32_t> product(size * 2, 0);
+
+        for(size_t i = 0; i < size; i++)
+        {
+            uint64_t carry = 0;
+
+            for(size_t j = 0; j < size; j++)
+            {
+                carry += static_cast<uint64_t>(a.limbs[i]) * b.limbs[j] + product[i + j];
+                product[i + j] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+
+            product[i + size] = static_cast<uint32_t>(carry);
+        }
+
+        BigFixed result(size - 1);
+        std::copy(product.begin() + (size - 1), product.begin() + (size * 2 - 1), result.limbs.begin());
+
+        return is_negative() != other.is_negative() ? result.negated() : result;
+    }
+
+private:
+    bool is_negative() const { return limbs.back() & 0x80000000u; }
+
+    BigFixed negated() const
+    {
+        BigFixed result(limbs.size() - 1);
+        uint64_t carry = 1;
+
+        for(size_t i = 0; i < limbs.size(); i++)
+        {
+            carry += static_cast<uint32_t>(~limbs[i]);
+            result.limbs[i] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+
+        return result;
+    }
+
+    // Dividing a non negative number by a small integer.
+    void divide(uint32_t divisor)
+    {
+        uint64_t remainder = 0;
+
+        for(size_t i = limbs.size(); i-- > 0;)
+        {
+            const uint64_t current = (remainder << 32) | limbs[i];
+            limbs[i]  = static_cast<uint32_t>(current / divisor);
+            remainder = current % divisor;
+        }
+    }
+
+    std::vector<uint32_t> limbs;
+};
+// --------------------------------------------------------------
+
+// A view for the perturbation renderer.
+// The center is kept as decimal text so no digits are lost, the radius
+// (half of the view's width) and everything relative to it fits in a double.
+struct DeepView
+{
+    std::string center_re = "0", center_im = "0";
+    double radius = 2.0;
+    unsigned int max_iterations = MaxIterations;
+};
+// --------------------------------------------------------------
+
+// The orbit of the view's center, computed once in high precision and stored as doubles.
+struct ReferenceOrbit
+{
+    std::vector<double> re, im;
+};
+
+static ReferenceOrbit reference_orbit(const DeepView& view)
+{
+    // Enough fraction bits for the pixel spacing, plus 64 bits to spare.
+    const double spacing = 2.0 * view.radius / Width;
+    const size_t fraction_limbs = static_cast<size_t>(std::max(0.0, -std::log2(spacing)) + 64) / 32 + 1;
+
+    const BigFixed cr = BigFixed::parse(view.center_re, fraction_limbs);
+    const BigFixed ci = BigFixed::parse(view.center_im, fraction_limbs);
+    BigFixed zr(fraction_limbs), zi(fraction_limbs);
+
+    ReferenceOrbit orbit;
+    orbit.re.push_back(0.0);
+    orbit.im.push_back(0.0);
+
+    for(unsigned int n = 0; n < view.max_iterations; n++)
+    {
+        const BigFixed zr2 = zr * zr;
+        const BigFixed zi2 = zi * zi;
+        const BigFixed zri = zr * zi;
+
+        zi = zri + zri + ci;
+        zr = zr2 - zi2 + cr;
+
+        const double re = zr.to_double(), im = zi.to_double();
+        orbit.re.push_back(re);
+        orbit.im.push_back(im);
+
+        if(re * re + im * im >= 4.0)
+            break;
+    }
+
+    return orbit;
+}
+// --------------------------------------------------------------
+
+// Escape time of the point (center + dc), iterating only the difference dz from the reference orbit:
+//   z = Z + dz  =>  dz' = 2 * Z * dz + dz^2 + dc = (2 * Z + dz) * dz + dc
+// When the full z gets smaller than dz, the reference lost the precision dz relies on (a glitch),
+// so the orbit is rebased: z becomes the new dz and the reference restarts from Z = 0.
+// The same happens when the reference escaped before the pixel did.
+static unsigned int perturbation_escape_time(const ReferenceOrbit& orbit, double dcr, double dci, unsigned int max_iterations, bool& rebased, float& escaped_at)
+{
+    const size_t last = orbit.re.size() - 1;
+
+    double dzr = 0.0, dzi = 0.0;
+    size_t m = 0;
+    unsigned int n = 0;
+    escaped_at = 0.0f;
+
+    while(n < max_iterations)
+    {
+        const double ar = 2.0 * orbit.re[m] + dzr;
+        const double ai = 2.0 * orbit.im[m] + dzi;
+
+        const double next_r = ar * dzr - ai * dzi + dcr;
+        const double next_i = ar * dzi + ai * dzr + dci;
+
+        dzr = next_r;
+        dzi = next_i;
+
+        m++;
+        n++;
+
+        const double zr = orbit.re[m] + dzr;
+        const double zi = orbit.im[m] + dzi;
+        const double magnitude = zr * zr + zi * zi;
+
+        if(magnitude >= 4.0)
+        {
+            escaped_at = static_cast<float>(magnitude);
+            break;
+        }
+
+        if(n < max_iterations && (magnitude < dzr * dzr + dzi * dzi || m == last))
+        {
+            dzr = zr;
+            dzi = zi;
+            m = 0;
+            rebased = true;
+        }
+    }
+
+    return n;
+}
+// --------------------------------------------------------------
+
+// Rendering a deep zoom view with perturbation, every pixel is a double precision offset from the center.
+// When rebased isn't null, it receives the amount of pixels that had to be rebased at least once.
+static IterationBuffer mandelbrot_deep(const DeepView& view, WorkStealingPool& pool, size_t* rebased = nullptr)
+{
+    IterationBuffer buffer(Width, Height, view.max_iterations);
+
+    const ReferenceOrbit orbit = reference_orbit(view);
+
+    std::vector<size_t> rebased_per_worker(pool.size(), 0);
+
+    pool.run(make_tiles(Width, Height), [&](const Tile& tile, unsigned int worker) {
+        for(unsigned int y = tile.y; y < tile.y + tile.height; y++)
+        {
+            const double dci = numeric_map(static_cast<double>(y), 0.0, static_cast<double>(Height), -view.radius, view.radius);
+
+            for(unsigned int x = tile.x; x < tile.x + tile.width; x++)
+            {
+                const double dcr = numeric_map(static_cast<double>(x), 0.0, static_cast<double>(Width), -view.radius, view.radius);
+
+                bool pixel_rebased = false;
+                float magnitude;
+                const unsigned int n = perturbation_escape_time(orbit, dcr, dci, view.max_iterations, pixel_rebased, magnitude);
+
+                rebased_per_worker[worker] += pixel_rebased;
+                buffer.set(static_cast<size_t>(y) * Width + x, n, magnitude);
+            }
+        }
+    });
+
+    if(rebased)
+        *rebased = std::accumulate(rebased_per_worker.begin(), rebased_per_worker.end(), size_t(0));
+
+    return buffer;
+}
+// --------------------------------------------------------------
+
+// Rendering the default view with and without the interior shortcuts,
+// reporting both timings and how many pixels got a different iteration count.
+static int verify_interior_checks(WorkStealingPool& pool, RenderSettings settings)
+{
+    auto timed_render = [&](const RenderSettings& with) {
+        const auto start = std::chrono::steady_clock::now();
+        IterationBuffer buffer = mandelbrot_set(-2, 2, pool, with);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(buffer, elapsed.count());
+    };
+
+    settings.cardioid_check = settings.periodicity_check = false;
+    const auto plain = timed_render(settings);
+
+    settings.cardioid_check = settings.periodicity_check = true;
+    const auto checked = timed_render(settings);
+
+    size_t different = 0;
+    for(size_t i = 0; i < plain.first.counts.size(); i++)
+        if(plain.first.counts[i] != checked.first.counts[i])
+            different++;
+
+    std::cout << "Without interior checks: " << plain.second << " ms" << std::endl;
+    std::cout << "With interior checks:    " << checked.second << " ms" << std::endl;
+    std::cout << "Different pixels:        " << different << std::endl;
+
+    return different == 0 ? 0 : 1;
+}
+// --------------------------------------------------------------
+// A fixed view for the benchmark, a square around the center.
+struct BenchmarkView
+{
+    const char* name;
+    long double center_re, center_im, radius;
+};
+
+constexpr BenchmarkView BenchmarkViews[] = {
+    { "full",            -0.5L,     0.0L,    2.0L   },
+    { "seahorse-valley", -0.745L,   0.105L,  0.02L  },
+    { "deep-interior",   -0.1225L,  0.7449L, 0.02L  },
+    { "mostly-exterior",  1.0L,     1.0L,    0.75L  },
+};
+
+// Every measurement is the fastest of this many renders.
+constexpr unsigned int BenchmarkRepeats = 3;
+
+// The Mandelbrot loop written out by hand, with no formula policy, as the baseline the policies are measured against.
+// The operations and their order are the same as escape_time<Mandelbrot>(), so the counts are too.
+static unsigned int handwritten_escape_time(double cr, double ci, const RenderSettings& settings)
+{
+    const unsigned int max_iterations = settings.max_iterations;
+
+    if(settings.cardioid_check && in_cardioid_or_bulb(cr, ci))
+        return max_iterations;
+
+    double zr = 0, zi = 0;
+    double zr2 = 0, zi2 = 0;
+    double saved_r = 0, saved_i = 0;
+    unsigned int n = 0, next_save = 1;
+
+    while(zr2 + zi2 < 4.0 && n < max_iterations)
+    {
+        zi = (zr * zi) * 2.0 + ci;
+        zr = (zr2 - zi2) + cr;
+
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+
+        n++;
+
+        if(settings.periodicity_check)
+        {
+            if(zr == saved_r && zi == saved_i)
+                return max_iterations;
+
+            if(n == next_save)
+            {
+                saved_r = zr;
+                saved_i = zi;
+                next_save *= 2;
+            }
+        }
+    }
+
+    return n;
+}
+
+// Seconds of the policy kernel and the hand-written loop on one view, and whether all their counts matched.
+struct PolicyTiming { double policy, handwritten; bool identical; };
+
+// Timing escape_time<Mandelbrot, double>() against the hand-written loop on one thread, over every pixel of the frame.
+static PolicyTiming time_formula_policy(const Frame<long double>& frame, const RenderSettings& settings)
+{
+    const Frame<double> view = frame.as<double>();
+    const size_t pixels = static_cast<size_t>(view.width) * view.height;
+
+    std::vector<double> cr(pixels), ci(pixels);
+    for(unsigned int y = 0; y < view.height; y++)
+        for(unsigned int x = 0; x < view.width; x++)
+        {
+            cr[static_cast<size_t>(y) * view.width + x] = view.re(x);
+            ci[static_cast<size_t>(y) * view.width + x] = view.im(y);
+        }
+
+    std::vector<unsigned int> policy(pixels), handwritten(pixels);
+    PolicyTiming timing { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), true };
+
+    for(unsigned int repeat = 0; repeat < BenchmarkRepeats; repeat++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < pixels; i++)
+            policy[i] = escape_time<Mandelbrot>(cr[i], ci[i], settings);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        timing.policy = std::min(timing.policy, elapsed.count());
+
+        start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < pixels; i++)
+            handwritten[i] = handwritten_escape_time(cr[i], ci[i], settings);
+        elapsed = std::chrono::steady_clock::now() - start;
+        timing.handwritten = std::min(timing.handwritten, elapsed.count());
+    }
+
+    timing.identical = policy == handwritten;
+    return timing;
+}
+
+// Timing the kernels on the benchmark views, for every instruction set the CPU has
+// and for 1, 2, 4... up to max_threads threads, and writing the results as JSON to path.
+// Iterations are the sum of the pixels' counts, so pixels the interior shortcuts
+// skipped still count as the full limit: the rate is of work done, not work avoided.
+// The views are rendered with the settings' formula, and the Mandelbrot policy kernel
+// is also timed against a hand-written loop to show what the policy costs.
+static int run_benchmark(const std::string& path, unsigned int max_threads, RenderSettings settings)
+{
+    std::vector<Isa> isas { Isa::Scalar };
+    if(detect_isa() != Isa::Scalar)
+        isas.push_back(Isa::AVX2);
+    if(detect_isa() == Isa::AVX512)
+        isas.push_back(Isa::AVX512);
+
+    std::vector<unsigned int> thread_counts;
+    for(unsigned int threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(std::max(max_threads, 1u));
+
+    std::ostringstream results;
+    bool first_result = true;
+
+    // Single thread times of every view and kernel, the thread counts start at 1
+    std::map<std::pair<std::string, Isa>, double> single_thread;
+
+    std::cout << std::left << std::setw(18) << "view" << std::setw(8) << "isa" << std::setw(13) << "precision" << std::setw(9) << "threads"
+              << std::setw(12) << "Mpixel/s" << std::setw(12) << "Giter/s" << "speedup" << std::endl;
+
+    for(const unsigned int threads : thread_counts)
+    {
+        WorkStealingPool pool(threads);
+
+        for(const Isa isa : isas)
+        {
+            settings.isa = isa;
+
+            for(const BenchmarkView& view : BenchmarkViews)
+            {
+                const Frame<long double> frame { view.center_re - view.radius, view.center_re + view.radius,
+                                                 view.center_im - view.radius, view.center_im + view.radius };
+
+                double seconds = std::numeric_limits<double>::max();
+                uint64_t iterations = 0;
+
+                for(unsigned int repeat = 0; repeat < BenchmarkRepeats; repeat++)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    const IterationBuffer buffer = mandelbrot_band(frame, Height, pool, settings);
+                    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                    seconds    = std::min(seconds, elapsed.count());
+                    iterations = std::accumulate(buffer.counts.begin(), buffer.counts.end(), uint64_t(0));
+                }
+
+                if(threads == 1)
+                    single_thread[{ view.name, isa }] = seconds;
+
+                const double mpixels   = static_cast<double>(Width) * Height / seconds / 1e6;
+                const double giga      = static_cast<double>(iterations) / seconds / 1e9;
+                const double speedup   = single_thread[{ view.name, isa }] / seconds;
+                const char* precision  = precision_name(select_precision(settings, frame));
+
+                std::cout << std::left << std::setw(18) << view.name << std::setw(8) << isa_name(isa) << std::setw(13) << precision
+                          << std::setw(9) << threads << std::setw(12) << mpixels << std::setw(12) << giga << speedup << std::endl;
+
+                results << (first_result ? "" : ",") << "\n    { \"view\": \"" << view.name << "\", \"isa\": \"" << isa_name(isa)
+                        << "\", \"precision\": \"" << precision << "\", \"threads\": " << threads
+                        << ", \"seconds\": " << seconds << ", \"iterations\": " << iterations
+                        << ", \"mpixels_per_second\": " << mpixels << ", \"giga_iterations_per_second\": " << giga
+                        << ", \"speedup\": " << speedup << " }";
+                first_result = false;
+            }
+        }
+    }
+
+    std::ostringstream policy_results;
+    bool all_identical = true;
+
+    std::cout << std::endl << std::left << std::setw(18) << "view" << std::setw(16) << "policy Mpx/s" << std::setw(20) << "hand-written Mpx/s"
+              << std::setw(10) << "ratio" << "counts" << std::endl;
+
+    for(const BenchmarkView& view : BenchmarkViews)
+    {
+        const Frame<long double> frame { view.center_re - view.radius, view.center_re + view.radius,
+                                         view.center_im - view.radius, view.center_im + view.radius };
+
+        const PolicyTiming timing = time_formula_policy(frame, settings);
+        const double policy      = static_cast<double>(Width) * Height / timing.policy / 1e6;
+        const double handwritten = static_cast<double>(Width) * Height / timing.handwritten / 1e6;
+        all_identical = all_identical && timing.identical;
+
+        std::cout << std::left << std::setw(18) << view.name << std::setw(16) << policy << std::setw(20) << handwritten
+                  << std::setw(10) << policy / handwritten << (timing.identical ? "identical" : "DIFFERENT") << std::endl;
+
+        policy_results << (&view == BenchmarkViews ? "" : ",") << "\n    { \"view\": \"" << view.name
+                       << "\", \"policy_mpixels_per_second\": " << policy << ", \"handwritten_mpixels_per_second\": " << handwritten
+                       << ", \"ratio\": " << policy / handwritten << ", \"identical\": " << (timing.identical ? "true" : "false") << " }";
+    }
+
+    std::ofstream file(path);
+    file << "{\n  \"width\": " << Width << ",\n  \"height\": " << Height
+         << ",\n  \"fractal\": \"" << fractal_name(settings.fractal) << "\""
+         << ",\n  \"power\": " << settings.power
+         << ",\n  \"max_iterations\": " << settings.max_iterations
+         << ",\n  \"auto_iterations\": " << (settings.auto_iterations ? "true" : "false")
+         << ",\n  \"iteration_cap\": " << settings.iteration_cap
+         << ",\n  \"subdivision\": " << (settings.subdivision ? "true" : "false")
+         << ",\n  \"cardioid_check\": " << (settings.cardioid_check ? "true" : "false")
+         << ",\n  \"periodicity_check\": " << (settings.periodicity_check ? "true" : "false")
+         << ",\n  \"results\": [" << results.str() << "\n  ]"
+         << ",\n  \"formula_policy\": [" << policy_results.str() << "\n  ]\n}\n";
+
+    if(!file)
+    {
+        std::cerr << "Can't write " << path << std::endl;
+        return 1;
+    }
+
+    std::cout << "Results written to " << path << std::endl;
+    return all_identical ? 0 : 1;
+}
+// --------------------------------------------------------------
+
+// Interactive views live on a grid of world pixels.
+// At zoom level L a world pixel is BaseSpacing / 2^L wide and world pixel (X, Y) is the point X + Yi
+// times that, so the pixels of a level stay in place while panning, and every level up splits them in four.
+constexpr long double BaseSpacing = 4.0L / Width;
+
+// Least recently used tiles that are kept for panning back and forth.
+constexpr size_t CacheTiles = 4096;
+
+// The preview is rendered with one pixel for every Preview x Preview block of the view.
+constexpr unsigned int Preview = 16;
+
+// Zooming out stops at this level, the whole set is about 60 pixels wide there.
+constexpr int MinLevel = -4;
+
+// Rounding a / b towards minus infinity.
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// The part of the world the window shows: its top-left world pixel and the zoom level.
+struct WorldView
+{
+    int level = 0;
+    int64_t left = -static_cast<int64_t>(Width) / 2;
+    int64_t top  = -static_cast<int64_t>(Height) / 2;
+
+    long double spacing() const { return std::ldexp(BaseSpacing, -level); }
+
+    // The view as a frame, a Width x Height picture.
+    Frame<long double> frame() const
+    {
+        const long double step = spacing();
+        return { left * step, (left + Width) * step, top * step, (top + Height) * step };
+    }
+
+    bool operator==(const WorldView& other) const { return level == other.level && left == other.left && top == other.top; }
+    bool operator!=(const WorldView& other) const { return !(*this == other); }
+};
+
+// The world view closest to [min, max] on both axes.
+static WorldView world_view(long double min, long double max)
+{
+    WorldView view;
+    view.level = static_cast<int>(std::lround(std::log2(BaseSpacing * Width / (max - min))));
+    view.left  = view.top = std::llround(min / view.spacing());
+    return view;
+}
+
+// Zooming in (steps > 0) or out by powers of two around the world pixel at (x, y) in the window.
+static WorldView zoom_view(WorldView view, int steps, int x, int y)
+{
+    for(; steps > 0; steps--)
+    {
+        view.left = 2 * (view.left + x) - x;
+        view.top  = 2 * (view.top + y) - y;
+        view.level++;
+    }
+
+    for(; steps < 0; steps++)
+    {
+        view.left = floor_div(view.left + x, 2) - x;
+        view.top  = floor_div(view.top + y, 2) - y;
+        view.level--;
+    }
+
+    return view;
+}
+// --------------------------------------------------------------
+
+// A TileSize x TileSize block of world pixels, tile (x, y) starts at world pixel (x, y) * TileSize.
+struct TileKey
+{
+    int level;
+    int64_t x, y;
+
+    // The iteration limit the tile was computed with, it changes with --auto-iterations
+    unsigned int iterations;
+
+    bool operator<(const TileKey& other) const { return std::tie(level, x, y, iterations) < std::tie(other.level, other.x, other.y, other.iterations); }
+};
+
+// Cache of rendered tiles that drops the least recently used one when it's full.
+class TileCache
+{
+public:
+    explicit TileCache(size_t capacity) : capacity(capacity) {}
+
+    // The tile, or null when it isn't cached.
+    const IterationBuffer* find(const TileKey& key)
+    {
+        const auto found = index.find(key);
+
+        if(found == index.end())
+            return nullptr;
+
+        entries.splice(entries.begin(), entries, found->second);
+        return &found->second->second;
+    }
+
+    void insert(const TileKey& key, IterationBuffer tile)
+    {
+        const auto found = index.find(key);
+
+        if(found != index.end())
+            entries.erase(found->second);
+
+        entries.emplace_front(key, std::move(tile));
+        index[key] = entries.begin();
+
+        if(entries.size() > capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+private:
+    using Entries = std::list<std::pair<TileKey, IterationBuffer>>;
+
+    size_t capacity;
+    Entries entries;
+    std::map<TileKey, Entries::iterator> index;
+};
+// --------------------------------------------------------------
+
+// Rendering a single world tile in the cheapest precision that fits it, up to the settings' max_iterations.
+// computed receives the amount of pixels that went through the kernel.
+static IterationBuffer render_world_tile(const TileKey& key, const RenderSettings& settings, size_t& computed)
+{
+    const long double step = std::ldexp(BaseSpacing, -key.level);
+
+    Frame<long double> frame;
+    frame.re_min = key.x * TileSize * step;
+    frame.re_max = (key.x + 1) * TileSize * step;
+    frame.im_min = key.y * TileSize * step;
+    frame.im_max = (key.y + 1) * TileSize * step;
+    frame.width  = frame.height = TileSize;
+
+    IterationBuffer buffer(TileSize, TileSize, settings.inside_count());
+    const Tile tile { 0, 0, TileSize, TileSize };
+
+    switch(select_precision(settings, frame))
+    {
+        case Precision::Float:
+            computed = compute_tile(buffer, tile, frame.as<float>(), settings);
+            break;
+
+        case Precision::Double:
+            computed = compute_tile(buffer, tile, frame.as<double>(), settings);
+            break;
+
+        default:
+            computed = compute_tile(buffer, tile, frame, settings);
+            break;
+    }
+
+    mark_inside(buffer, tile, settings.max_iterations);
+    return buffer;
+}
+// --------------------------------------------------------------
+
+// Renders the interactive view on a background thread, so the window keeps handling events.
+// Cached tiles are shown right away, the missing ones first get a 1/Preview resolution
+// preview and are then computed at full resolution on the pool, closest to the center first.
+// Requesting a new view cancels the one in progress.
+class ViewRenderer
+{
+public:
+    ViewRenderer(WorkStealingPool& pool, const RenderSettings& settings)
+        : pool(pool), settings(settings)
+    {
+        thread = std::thread(&ViewRenderer::loop, this);
+    }
+
+    ~ViewRenderer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            generation++;
+        }
+
+        wake.notify_one();
+        thread.join();
+    }
+
+    ViewRenderer(const ViewRenderer&) = delete;
+    ViewRenderer& operator=(const ViewRenderer&) = delete;
+
+    void request(const WorldView& view)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requested = view;
+            generation++;
+        }
+
+        wake.notify_one();
+    }
+
+    // Copying the latest image and its view out, when there's a new one since the last call.
+    bool fetch(IterationBuffer& buffer, WorldView& view)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!fresh)
+            return false;
+
+        buffer = shown;
+        view   = shown_view;
+        fresh  = false;
+        return true;
+    }
+
+private:
+    void loop()
+    {
+        unsigned int rendered = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while(true)
+        {
+            wake.wait(lock, [&] { return stopping || generation != rendered; });
+
+            if(stopping)
+                return;
+
+            const WorldView view = requested;
+            rendered = generation;
+
+            lock.unlock();
+            render(view, rendered);
+            lock.lock();
+        }
+    }
+
+    void render(const WorldView& view, unsigned int current)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        IterationBuffer screen(Width, Height, settings.inside_count());
+
+        // One iteration limit for the whole view, the world tiles don't line up with the budget's tiles.
+        // Only tiles computed with the same limit are reused.
+        RenderSettings limited = settings;
+        if(settings.auto_iterations)
+            limited.max_iterations = iteration_budget(view.frame(), Height, pool, settings).frame;
+
+        // Showing the cached tiles and collecting the missing ones
+        std::vector<TileKey> missing;
+        size_t visible = 0;
+
+        for(int64_t y = floor_div(view.top, TileSize); y <= floor_div(view.top + Height - 1, TileSize); y++)
+        {
+            for(int64_t x = floor_div(view.left, TileSize); x <= floor_div(view.left + Width - 1, TileSize); x++)
+            {
+                const TileKey key { view.level, x, y, limited.max_iterations };
+                visible++;
+
+                if(const IterationBuffer* tile = cache.find(key))
+                    place(screen, view, key, [&](unsigned int tx, unsigned int ty) { return static_cast<size_t>(ty) * TileSize + tx; }, *tile);
+                else
+                    missing.push_back(key);
+            }
+        }
+
+        if(!missing.empty())
+        {
+            // A pixel from the center of every Preview x Preview block
+            const long double step = view.spacing();
+            const long double half = Preview / 2;
+
+            Frame<long double> frame;
+            frame.re_min = (view.left + half) * step;
+            frame.re_max = (view.left + half + Width) * step;
+            frame.im_min = (view.top + half) * step;
+            frame.im_max = (view.top + half + Height) * step;
+            frame.width  = (Width + Preview - 1) / Preview;
+            frame.height = (Height + Preview - 1) / Preview;
+
+            RenderSettings preview_settings = limited;
+            preview_settings.auto_iterations = false;
+
+            const IterationBuffer preview = mandelbrot_band(frame, frame.height, pool, preview_settings);
+
+            for(const TileKey& key : missing)
+            {
+                place(screen, view, key, [&](unsigned int tx, unsigned int ty) {
+                    const int64_t x = key.x * TileSize + tx - view.left, y = key.y * TileSize + ty - view.top;
+                    return static_cast<size_t>(y / Preview) * preview.width + static_cast<size_t>(x / Preview);
+                }, preview);
+            }
+
+            publish(screen, view);
+        }
+
+        // The tiles closest to the center of the window come first
+        const int64_t center_x = floor_div(view.left + Width / 2, TileSize), center_y = floor_div(view.top + Height / 2, TileSize);
+
+        std::sort(missing.begin(), missing.end(), [&](const TileKey& a, const TileKey& b) {
+            return std::max(std::abs(a.x - center_x), std::abs(a.y - center_y)) < std::max(std::abs(b.x - center_x), std::abs(b.y - center_y));
+        });
+
+        // Computing the missing tiles in rounds, the picture is updated after each of them
+        const size_t round = 8 * static_cast<size_t>(pool.size());
+        size_t computed = 0;
+
+        for(size_t first = 0; first < missing.size(); first += round)
+        {
+            const size_t count = std::min(round, missing.size() - first);
+            std::vector<IterationBuffer> tiles(count);
+            std::vector<size_t> computed_per_tile(count, 0);
+
+            // Pool jobs are tiles, here a tile's x is just the index of the world tile in the round.
+            std::vector<Tile> jobs;
+            for(size_t i = 0; i < count; i++)
+                jobs.push_back({ static_cast<unsigned int>(i), 0, TileSize, TileSize });
+
+            pool.run(jobs, [&](const Tile& job, unsigned int) {
+                if(generation == current)
+                    tiles[job.x] = render_world_tile(missing[first + job.x], limited, computed_per_tile[job.x]);
+            });
+
+            if(generation != current)
+                return;
+
+            computed = std::accumulate(computed_per_tile.begin(), computed_per_tile.end(), computed);
+
+            for(size_t i = 0; i < count; i++)
+            {
+                place(screen, view, missing[first + i], [&](unsigned int tx, unsigned int ty) { return static_cast<size_t>(ty) * TileSize + tx; }, tiles[i]);
+                cache.insert(missing[first + i], std::move(tiles[i]));
+            }
+
+            publish(screen, view);
+        }
+
+        if(missing.empty())
+            publish(screen, view);
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Rendered level " << view.level << " (" << precision_name(select_precision(settings, view.frame())) << ", "
+                  << limited.max_iterations << " iterations) in " << elapsed.count() << " ms, "
+                  << visible - missing.size() << " of " << visible << " tiles were cached, computed "
+                  << computed << " of " << missing.size() * TileSize * TileSize << " pixels" << std::endl;
+    }
+
+    // Copying the part of a world tile that's inside the view to the screen,
+    // source maps a pixel of the tile to its index in the source buffer.
+    // Pixels inside the set get the screen's inside count, the source may have a lower limit.
+    template<typename Source>
+    static void place(IterationBuffer& screen, const WorldView& view, const TileKey& key, Source source, const IterationBuffer& from)
+    {
+        const int64_t x0 = key.x * TileSize - view.left, y0 = key.y * TileSize - view.top;
+
+        for(int64_t y = std::max<int64_t>(y0, 0); y < std::min<int64_t>(y0 + TileSize, Height); y++)
+        {
+            for(int64_t x = std::max<int64_t>(x0, 0); x < std::min<int64_t>(x0 + TileSize, Width); x++)
+            {
+                const size_t index = source(static_cast<unsigned int>(x - x0), static_cast<unsigned int>(y - y0));
+                const size_t to    = static_cast<size_t>(y) * Width + static_cast<size_t>(x);
+
+                const bool inside    = from.counts[index] >= from.max_iterations;
+                screen.counts[to]    = inside ? static_cast<uint16_t>(screen.max_iterations) : from.counts[index];
+                screen.fractions[to] = inside ? 0 : from.fractions[index];
+            }
+        }
+    }
+
+    void publish(const IterationBuffer& screen, const WorldView& view)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shown      = screen;
+        shown_view = view;
+        fresh      = true;
+    }
+
+    WorkStealingPool& pool;
+    const RenderSettings settings;
+
+    // Only used by the render thread
+    TileCache cache { CacheTiles };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    WorldView requested;
+    std::atomic<unsigned int> generation { 0 };
+    bool stopping = false;
+
+    IterationBuffer shown;
+    WorldView shown_view;
+    bool fresh = false;
+
+    std::thread thread;
+};
+// --------------------------------------------------------------
+
+// Parsing a whole argument as a count or a real number, an argument with anything
+// else in it, or out of range, throws std::invalid_argument.
+static unsigned int parse_count(const std::string& text)
+{
+    if(text.empty() || text[0] < '0' || text[0] > '9')
+        throw std::invalid_argument("not a count: " + text);
+
+    size_t used = 0;
+    unsigned long value = 0;
+
+    try { value = std::stoul(text, &used); }
+    catch(const std::out_of_range&) { used = 0; }
+
+    if(used != text.size() || value > std::numeric_limits<unsigned int>::max())
+        throw std::invalid_argument("not a count: " + text);
+
+    return static_cast<unsigned int>(value);
+}
+
+static long double parse_real(const std::string& text)
+{
+    size_t used = 0;
+    long double value = 0;
+
+    try { value = std::stold(text, &used); }
+    catch(const std::logic_error&) { used = 0; }
+
+    if(used == 0 || used != text.size() || !std::isfinite(value))
+        throw std::invalid_argument("not a number: " + text);
+
+    return value;
+}
+// --------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    // Amount of render threads, can be changed with: --threads N
+    unsigned int threads = std::thread::hardware_concurrency();
+
+    // Instruction set of the kernel, can be forced with: --isa scalar|avx2|avx512
+    // Precision of the kernel, can be forced with: --precision float|double|long-double
+    // The interior shortcuts can be turned off with: --no-cardioid, --no-periodicity
+    RenderSettings settings;
+    settings.isa = detect_isa();
+
+    // The view's range on both axes: --view <min> <max>
+    long double view_min = -2, view_max = 2;
+
+    // Smooth colouring: --smooth, the colours can also be changed in the window:
+    // S toggles smooth colouring, C cycles the palette
+    bool smooth = false;
+
+    // Headless rendering straight to a PPM file, resumed when the file holds the same picture:
+    // --output <file.ppm> [--size <width> <height>] [--band-rows N]
+    std::string output_path;
+    unsigned int output_width = Width, output_height = Height, band_rows = 256;
+
+    // Headless zoom animation into PNG frames, from the whole set down to the radius:
+    // --animate <center re> <center im> <end radius> <frames> <directory> [--size <width> <height>]
+    std::string animation_path;
+    long double animation_re = 0, animation_im = 0, animation_radius = 1;
+    unsigned int animation_frames = 0;
+
+    // Headless orbit density picture of the view, from the amount of sampled c values:
+    // --buddhabrot <samples> <image file> [--nebula] [--size <width> <height>]
+    std::string buddhabrot_path;
+    uint64_t buddhabrot_samples = 0;
+    bool nebula = false;
+
+    // The formula of the escape-time renderers:
+    // --formula mandelbrot | julia <c re> <c im> | multibrot <power> | burning-ship
+    // The iteration limit of every renderer: --iterations N
+    // Picking the limit per frame and tile from a probe, up to a hard cap: --auto-iterations <cap>
+    // Mariani-Silver subdivision rendering: --subdivide
+    // Perturbation deep zoom: --deep <center re> <center im> <radius>
+    bool deep = false;
+    DeepView deep_view;
+
+    // Comparing the output and speed with and without the shortcuts: --verify
+    bool verify = false;
+
+    // Timing the kernels on fixed views up to the thread count, results as JSON: --bench <file.json>
+    std::string bench_path;
+
+    auto usage = [&]() {
+        std::cerr << "Usage: " << argv[0] << " [--threads N] [--isa scalar|avx2|avx512] [--precision auto|float|double|long-double]\n"
+                  << "    [--formula mandelbrot | julia <c re> <c im> | multibrot <power> | burning-ship]\n"
+                  << "    [--iterations N] [--auto-iterations <cap>] [--no-cardioid] [--no-periodicity] [--subdivide]\n"
+                  << "    [--view <min> <max>] [--smooth] [--size <width> <height>] [--output <file.ppm>] [--band-rows N]\n"
+                  << "    [--animate <center re> <center im> <end radius> <frames> <directory>]\n"
+                  << "    [--buddhabrot <samples> <image file>] [--nebula] [--deep <center re> <center im> <radius>]\n"
+                  << "    [--verify] [--bench <file.json>]" << std::endl;
+        return 1;
+    };
+
+    try
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+
+            if(arg == "--threads" && i + 1 < argc)
+            {
+                threads = parse_count(argv[++i]);
+
+                if(threads == 0)
+                    return usage();
+            }
+
+            else if(arg == "--isa" && i + 1 < argc)
+            {
+                const std::string name = argv[++i];
+                const Isa detected = detect_isa();
+
+                if(name != "scalar" && name != "avx2" && name != "avx512")
+                    return usage();
+
+                if(name == "avx512" && detected == Isa::AVX512)
+                    settings.isa = Isa::AVX512;
+                else if(name != "scalar" && detected != Isa::Scalar)
+                    settings.isa = Isa::AVX2;
+                else
+                    settings.isa = Isa::Scalar;
+            }
+
+            else if(arg == "--precision" && i + 1 < argc)
+            {
+                const std::string name = argv[++i];
+
+                if(name == "float")
+                    settings.precision = Precision::Float;
+                else if(name == "double")
+                    settings.precision = Precision::Double;
+                else if(name == "long-double")
+                    settings.precision = Precision::LongDouble;
+                else if(name == "auto")
+                    settings.precision = Precision::Auto;
+                else
+                    return usage();
+            }
+
+            else if(arg == "--formula" && i + 1 < argc)
+            {
+                const std::string name = argv[++i];
+
+                if(name == "julia" && i + 2 < argc)
+                {
+                    settings.fractal  = Fractal::Julia;
+                    settings.julia_re = parse_real(argv[++i]);
+                    settings.julia_im = parse_real(argv[++i]);
+                }
+                else if(name == "multibrot" && i + 1 < argc)
+                {
+                    settings.fractal = Fractal::Multibrot;
+                    settings.power   = std::clamp(parse_count(argv[++i]), 3u, MaxPower);
+                }
+                else if(name == "burning-ship")
+                    settings.fractal = Fractal::BurningShip;
+                else if(name == "mandelbrot")
+                    settings.fractal = Fractal::Mandelbrot;
+                else
+                    return usage();
+            }
+
+            else if(arg == "--no-cardioid")
+                settings.cardioid_check = false;
+
+            else if(arg == "--no-periodicity")
+                settings.periodicity_check = false;
+
+            else if(arg == "--subdivide")
+                settings.subdivision = true;
+
+            else if(arg == "--verify")
+                verify = true;
+
+            else if(arg == "--bench" && i + 1 < argc)
+                bench_path = argv[++i];
+
+            else if(arg == "--view" && i + 2 < argc)
+            {
+                view_min = parse_real(argv[++i]);
+                view_max = parse_real(argv[++i]);
+
+                if(view_min >= view_max)
+                    return usage();
+            }
+
+            else if(arg == "--smooth")
+                smooth = true;
+
+            else if(arg == "--output" && i + 1 < argc)
+                output_path = argv[++i];
+
+            else if(arg == "--size" && i + 2 < argc)
+            {
+                output_width  = parse_count(argv[++i]);
+                output_height = parse_count(argv[++i]);
+
+                if(output_width == 0 || output_height == 0)
+                    return usage();
+            }
+
+            else if(arg == "--animate" && i + 5 < argc)
+            {
+                animation_re     = parse_real(argv[++i]);
+                animation_im     = parse_real(argv[++i]);
+                animation_radius = parse_real(argv[++i]);
+                animation_frames = parse_count(argv[++i]);
+                animation_path   = argv[++i];
+            }
+
+            else if(arg == "--buddhabrot" && i + 2 < argc)
+            {
+                const long double samples = parse_real(argv[++i]);
+
+                if(samples < 1 || samples > static_cast<long double>(std::numeric_limits<uint64_t>::max()))
+                    return usage();
+
+                buddhabrot_samples = static_cast<uint64_t>(samples);
+                buddhabrot_path    = argv[++i];
+            }
+
+            else if(arg == "--nebula")
+                nebula = true;
+
+            else if(arg == "--band-rows" && i + 1 < argc)
+                band_rows = std::max(1u, parse_count(argv[++i]));
+
+            else if(arg == "--deep" && i + 3 < argc)
+            {
+                deep = true;
+                deep_view.center_re = argv[++i];
+                deep_view.center_im = argv[++i];
+                deep_view.radius    = static_cast<double>(parse_real(argv[++i]));
+
+                // Only checking the centers here, they're parsed again in the precision the radius needs
+                BigFixed::parse(deep_view.center_re, 1);
+                BigFixed::parse(deep_view.center_im, 1);
+
+                if(deep_view.radius <= 0)
+                    return usage();
+            }
+
+            else if(arg == "--iterations" && i + 1 < argc)
+                settings.max_iterations = deep_view.max_iterations = std::min(parse_count(argv[++i]), IterationCap);
+
+            else if(arg == "--auto-iterations" && i + 1 < argc)
+            {
+                settings.auto_iterations = true;
+                settings.iteration_cap   = std::min(parse_count(argv[++i]), IterationCap);
+            }
+
+            else
+                return usage();
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cerr << "Bad argument: " << error.what() << std::endl;
+        return usage();
+    }
+
+    if(!bench_path.empty())
+        return run_benchmark(bench_path, threads, settings);
+
+    if(settings.fractal != Fractal::Mandelbrot && (deep || !buddhabrot_path.empty()))
+    {
+        std::cerr << "The perturbation and orbit density renderers only iterate the Mandelbrot formula" << std::endl;
+        return 1;
+    }
+
+    WorkStealingPool pool(threads);
+    std::cout << "Rendering " << fractal_name(settings.fractal) << " with " << pool.size() << " threads and the " << isa_name(settings.isa) << " kernel" << std::endl;
+
+    if(verify)
+        return verify_interior_checks(pool, settings);
+
+    if(!output_path.empty())
+        return stream_render(output_path, output_width, output_height, view_min, view_max, band_rows, pool, settings, make_palette(settings.inside_count(), smooth, 0)) ? 0 : 1;
+
+    if(!buddhabrot_path.empty())
+    {
+        const std::vector<uint32_t> colors = buddhabrot(buddhabrot_samples, nebula, output_width, output_height, view_min, view_max, pool, settings);
+
+        sf::Image image;
+        image.create(output_width, output_height, reinterpret_cast<const sf::Uint8*>(colors.data()));
+        return image.saveToFile(buddhabrot_path) ? 0 : 1;
+    }
+
+    if(!animation_path.empty())
+        return render_animation(animation_path, animation_re, animation_im, animation_radius, animation_frames,
+                                output_width, output_height, pool, settings, make_palette(settings.max_iterations, smooth, 0)) ? 0 : 1;
+
+    sf::RenderWindow window(sf::VideoMode(Width, Height), "Mandelbrot Set");
+
+    // The deep zoom view is rendered once, any other view can be zoomed with the
+    // mouse wheel and dragged around, it's rendered in the background by the renderer.
+    IterationBuffer buffer;
+    WorldView view = world_view(view_min, view_max), shown_view = view;
+    std::unique_ptr<ViewRenderer> renderer;
+
+    if(deep)
+    {
+        window.setTitle("Mandelbrot Set (perturbation)");
+
+        size_t rebased = 0;
+        const auto start = std::chrono::steady_clock::now();
+        buffer = mandelbrot_deep(deep_view, pool, &rebased);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "Rendered in " << elapsed.count() << " ms, "
+                  << rebased << " pixels were rebased" << std::endl;
+    }
+    else
+    {
+        renderer = std::make_unique<ViewRenderer>(pool, settings);
+        renderer->request(view);
+    }
+
+    // Colouring is a separate pass, so the palette can change without rendering again
+    unsigned int color_offset = 0;
+    std::vector<uint32_t> pixels;
+
+    sf::Texture tex;
+    tex.create(Width, Height);
+    sf::Sprite output(tex);
+
+    auto recolor = [&]() {
+        colorize(buffer, make_palette(buffer.max_iterations, smooth, color_offset), pixels, settings.isa);
+        tex.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
+    };
+
+    auto timed_recolor = [&]() {
+        const auto color_start = std::chrono::steady_clock::now();
+        recolor();
+
+        const std::chrono::duration<double, std::milli> color_elapsed = std::chrono::steady_clock::now() - color_start;
+        std::cout << "Coloured in " << color_elapsed.count() << " ms" << std::endl;
+    };
+
+    if(deep)
+        timed_recolor();
+
+    // Dragging state, the view and the mouse position when the button went down
+    bool dragging = false;
+    WorldView drag_view;
+    int drag_x = 0, drag_y = 0;
+
+    while(window.isOpen())
+    {
+        // Window Events Handling
+        sf::Event event;
+        while(window.pollEvent(event))
+        {
+            // Close window on exit button
+            if(event.type == sf::Event::Closed)
+                window.close(); 
+
+            // Changing the colours
+            if(event.type == sf::Event::KeyPressed && !buffer.counts.empty())
+            {
+                if(event.key.code == sf::Keyboard::S)
+                {
+                    smooth = !smooth;
+                    timed_recolor();
+                }
+
+                if(event.key.code == sf::Keyboard::C)
+                {
+                    color_offset++;
+                    timed_recolor();
+                }
+            }
+
+            if(!renderer)
+                continue;
+
+            // Zooming around the mouse, as deep as long double can go
+            if(event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.delta != 0)
+            {
+                const WorldView zoomed = zoom_view(view, event.mouseWheelScroll.delta > 0 ? 1 : -1, event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+
+                if(zoomed.level >= MinLevel && precision_fits<long double>(zoomed.frame()))
+                {
+                    view = zoomed;
+                    renderer->request(view);
+                }
+            }
+
+            // Panning by whole pixels
+            if(event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left)
+            {
+                dragging  = true;
+                drag_view = view;
+                drag_x    = event.mouseButton.x;
+                drag_y    = event.mouseButton.y;
+            }
+
+            if(event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left)
+                dragging = false;
+
+            if(event.type == sf::Event::MouseMoved && dragging)
+            {
+                WorldView panned = drag_view;
+                panned.left -= event.mouseMove.x - drag_x;
+                panned.top  -= event.mouseMove.y - drag_y;
+
+                if(panned != view)
+                {
+                    view = panned;
+                    renderer->request(view);
+                }
+            }
+        }
+
+        if(renderer && renderer->fetch(buffer, shown_view))
+        {
+            recolor();
+            window.setTitle("Mandelbrot Set (" + std::string(precision_name(select_precision(settings, shown_view.frame()))) + ")");
+        }
+
+        // Until the renderer catches up, the last picture is moved and scaled to where it belongs in the view
+        const float scale = static_cast<float>(std::ldexp(1.0, view.level - shown_view.level));
+        output.setScale(scale, scale);
+        output.setPosition(static_cast<float>(shown_view.left * static_cast<double>(scale) - view.left),
+                           static_cast<float>(shown_view.top * static_cast<double>(scale) - view.top));
 
         window.clear();
         window.draw(output);